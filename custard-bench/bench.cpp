@@ -0,0 +1,323 @@
+#include <benchmark/benchmark.h>
+
+#include <json.h>
+#include <jsonsax.h>
+#include <jsonschema.h>
+#include <jsontape.h>
+#include <slackresponse.h>
+#include <utf.h>
+
+#if defined(_WIN32)
+#include <https.h>
+#endif
+
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <memory_resource>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace custard;
+
+//
+// Every allocation made through the global operator new is counted, so that each benchmark can
+// report how many allocations a document costs alongside its throughput.
+//
+
+// Kept out of line: GCC inlines the free() below into each delete expression and then warns that it
+// frees memory from operator new.
+#if defined(_MSC_VER)
+#define NOINLINE __declspec(noinline)
+#else
+#define NOINLINE __attribute__((noinline))
+#endif
+
+static std::atomic<size_t> s_allocations;
+
+NOINLINE void * operator new(size_t size)
+{
+	s_allocations.fetch_add(1, std::memory_order_relaxed);
+
+	if (auto ptr = std::malloc(size ? size : 1))
+	{
+		return ptr;
+	}
+
+	throw std::bad_alloc();
+}
+
+NOINLINE void operator delete(void * ptr) noexcept
+{
+	std::free(ptr);
+}
+
+NOINLINE void operator delete(void * ptr, size_t) noexcept
+{
+	std::free(ptr);
+}
+
+static const std::vector<std::byte> & Corpus(const std::string & name)
+{
+	static std::map<std::string, std::vector<std::byte>> files;
+
+	auto & data = files[name];
+
+	if (data.empty())
+	{
+		std::ifstream file(CUSTARD_CORPUS "/" + name, std::ios::binary);
+
+		if (!file)
+		{
+			throw std::runtime_error("Missing corpus file: " + name);
+		}
+
+		std::vector<char> bytes{ std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>() };
+		data.assign((const std::byte *) bytes.data(), (const std::byte *) bytes.data() + bytes.size());
+	}
+
+	return data;
+}
+
+template <typename Body>
+static void Measure(benchmark::State & state, const std::vector<std::byte> & data, Body && body)
+{
+	size_t allocations = 0;
+
+	for (auto _ : state)
+	{
+		auto before = s_allocations.load(std::memory_order_relaxed);
+		body(std::span<const std::byte>(data));
+		allocations += s_allocations.load(std::memory_order_relaxed) - before;
+	}
+
+	state.SetBytesProcessed((int64_t) (state.iterations() * data.size()));
+	state.counters["allocs/doc"] = benchmark::Counter((double) allocations / (double) state.iterations());
+}
+
+
+//
+// Pulls every token of the document through a single cursor, without materializing strings.
+//
+static void JsonTokenize(benchmark::State & state, const char * name)
+{
+	Measure(state, Corpus(name), [](std::span<const std::byte> data)
+	{
+		JsonContext context(data, 1024);
+		Json json(context);
+		size_t tokens = 0;
+
+		for (;;)
+		{
+			auto value = json.ParseView();
+
+			if (auto state = std::get_if<Json::State>(&value); state && *state == Json::State::End)
+			{
+				break;
+			}
+
+			++tokens;
+		}
+
+		benchmark::DoNotOptimize(tokens);
+	});
+}
+
+//
+// As above, but each string is decoded into a std::wstring as Parse() does.
+//
+static void JsonParse(benchmark::State & state, const char * name)
+{
+	Measure(state, Corpus(name), [](std::span<const std::byte> data)
+	{
+		JsonContext context(data, 1024);
+		Json json(context);
+
+		for (;;)
+		{
+			auto value = json.Parse();
+
+			if (auto state = std::get_if<Json::State>(&value); state && *state == Json::State::End)
+			{
+				break;
+			}
+
+			benchmark::DoNotOptimize(value);
+		}
+	});
+}
+
+struct CountingHandler
+{
+	size_t tokens = 0;
+
+	void OnKey(JsonString &&) { ++tokens; }
+	void OnString(JsonString &&) { ++tokens; }
+	void OnNumber(JsonNumber &&) { ++tokens; }
+	void OnBool(bool) { ++tokens; }
+	void OnNull() { ++tokens; }
+};
+
+static void JsonSax(benchmark::State & state, const char * name)
+{
+	Measure(state, Corpus(name), [](std::span<const std::byte> data)
+	{
+		CountingHandler handler;
+		ParseJson(data, handler, 1024);
+		benchmark::DoNotOptimize(handler.tokens);
+	});
+}
+
+static void JsonValidate(benchmark::State & state, const char * name)
+{
+	Measure(state, Corpus(name), [](std::span<const std::byte> data)
+	{
+		auto error = Json::Validate(data, 1024);
+		benchmark::DoNotOptimize(error);
+	});
+}
+
+static void JsonTapeBuild(benchmark::State & state, const char * name)
+{
+	Measure(state, Corpus(name), [](std::span<const std::byte> data)
+	{
+		JsonTape tape(data, 1024);
+		benchmark::DoNotOptimize(tape.size());
+	});
+}
+
+//
+// Binding a chat.postMessage response the way SlackApi does, with its strings in an arena that is
+// released before each document.
+//
+static void BindSlackApiResponse(benchmark::State & state, const char * name)
+{
+	std::byte buffer[4096];
+	std::pmr::monotonic_buffer_resource arena(buffer, sizeof(buffer));
+
+	Measure(state, Corpus(name), [&arena](std::span<const std::byte> data)
+	{
+		arena.release();
+
+		JsonContext context(data, JsonStack::DefaultMaxDepth, &arena);
+		Json json(context);
+		SlackApiResponse response;
+
+		BindJson(response, json);
+		benchmark::DoNotOptimize(response);
+	});
+}
+
+#define CORPUS_BENCHMARK(function) \
+	BENCHMARK_CAPTURE(function, slack_response, "slack-response.json"); \
+	BENCHMARK_CAPTURE(function, slack_history, "slack-history.json"); \
+	BENCHMARK_CAPTURE(function, nested, "nested.json"); \
+	BENCHMARK_CAPTURE(function, escapes, "escapes.json"); \
+	BENCHMARK_CAPTURE(function, numbers, "numbers.json")
+
+CORPUS_BENCHMARK(JsonTokenize);
+CORPUS_BENCHMARK(JsonParse);
+CORPUS_BENCHMARK(JsonSax);
+CORPUS_BENCHMARK(JsonValidate);
+CORPUS_BENCHMARK(JsonTapeBuild);
+
+BENCHMARK_CAPTURE(BindSlackApiResponse, slack_response, "slack-response.json");
+
+static void ConvertFromUtf8(benchmark::State & state, const char * name)
+{
+	Measure(state, Corpus(name), [](std::span<const std::byte> data)
+	{
+		auto text = ConvertFrom(std::u8string_view((const char8_t *) data.data(), data.size()));
+		benchmark::DoNotOptimize(text);
+	});
+}
+
+// Throughput is counted in bytes of the UTF-8 output, so that it compares with the other direction.
+static void ConvertFromWide(benchmark::State & state, const char * name)
+{
+	auto & data = Corpus(name);
+	auto wstr = ConvertFrom(data);
+
+	Measure(state, data, [&wstr](std::span<const std::byte>)
+	{
+		auto text = ConvertFrom(wstr);
+		benchmark::DoNotOptimize(text);
+	});
+}
+
+CORPUS_BENCHMARK(ConvertFromUtf8);
+CORPUS_BENCHMARK(ConvertFromWide);
+
+#if defined(_WIN32)
+
+//
+// Request latency against the server in CUSTARD_BENCH_URL, such as a local TLS stand-in at
+// https://localhost:8443/ whose certificate the machine trusts. Pooled requests share the process
+// session and its keep-alive sockets; the others open a session, and so a TLS handshake, each time.
+//
+
+static const wchar_t * BenchUrl()
+{
+	static const auto url = []() -> std::wstring
+	{
+		auto value = _wgetenv(L"CUSTARD_BENCH_URL");
+		return value ? value : L"";
+	}();
+
+	return url.empty() ? nullptr : url.c_str();
+}
+
+static void HttpsGetPooled(benchmark::State & state)
+{
+	if (!BenchUrl())
+	{
+		state.SkipWithError("CUSTARD_BENCH_URL is not set.");
+		return;
+	}
+
+	Url url(BenchUrl(), true);
+	Https https(url.Host().c_str(), url.Port());
+	auto path = url.Path();
+
+	for (auto _ : state)
+	{
+		auto content = https.Get(path.c_str()).GetContent();
+		benchmark::DoNotOptimize(content);
+	}
+}
+
+static void HttpsGetNewSession(benchmark::State & state)
+{
+	if (!BenchUrl())
+	{
+		state.SkipWithError("CUSTARD_BENCH_URL is not set.");
+		return;
+	}
+
+	Url url(BenchUrl(), true);
+	auto host = url.Host();
+	auto path = url.Path();
+
+	for (auto _ : state)
+	{
+		Session session;
+		Connection connection(session, host.c_str(), url.Port());
+		Request request(connection, L"GET", path.c_str());
+		request.Send(L"", nullptr, 0);
+
+		auto content = Response(request).GetContent();
+		benchmark::DoNotOptimize(content);
+	}
+}
+
+BENCHMARK(HttpsGetPooled)->UseRealTime();
+BENCHMARK(HttpsGetNewSession)->UseRealTime();
+
+#endif
+
+BENCHMARK_MAIN();
@@ -0,0 +1,78 @@
+#include "pch.h"
+#include <httpcache.h>
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+
+using namespace custard;
+
+class HttpCacheTest : public ::testing::Test
+{
+protected:
+	std::filesystem::path m_directory = std::filesystem::temp_directory_path() / "custard-test-http-cache";
+
+	void SetUp() override
+	{
+		std::filesystem::remove_all(m_directory);
+		std::filesystem::create_directories(m_directory);
+		std::ofstream(m_directory / "icon.png") << "png";
+	}
+
+	void TearDown() override
+	{
+		std::filesystem::remove_all(m_directory);
+	}
+};
+
+TEST_F(HttpCacheTest, StoreAndFind)
+{
+	HttpCache cache(m_directory / "index");
+	EXPECT_FALSE(cache.Find(L"https://example.com/icon.png"));
+
+	cache.Store({ L"https://example.com/icon.png", L"\"abc\"", L"Wed, 21 Oct 2015 07:28:00 GMT", m_directory / "icon.png", 42 });
+
+	auto entry = cache.Find(L"https://example.com/icon.png");
+	ASSERT_TRUE(entry);
+	EXPECT_EQ(entry->etag, L"\"abc\"");
+	EXPECT_EQ(entry->path, m_directory / "icon.png");
+	EXPECT_EQ(entry->expires, 42);
+	EXPECT_EQ(entry->ConditionalHeaders(), L"If-None-Match: \"abc\"\r\nIf-Modified-Since: Wed, 21 Oct 2015 07:28:00 GMT\r\n");
+
+	EXPECT_FALSE(cache.Find(L"https://example.com/other.png"));
+
+	// An entry whose file has gone is no use.
+	std::filesystem::remove(m_directory / "icon.png");
+	EXPECT_FALSE(cache.Find(L"https://example.com/icon.png"));
+}
+
+TEST_F(HttpCacheTest, Replace)
+{
+	HttpCache cache(m_directory / "index");
+	cache.Store({ L"https://example.com/icon.png", L"\"1\"", L"", m_directory / "icon.png", 0 });
+	cache.Store({ L"https://example.com/icon.png", L"\"2\"", L"", m_directory / "icon.png", 0 });
+
+	EXPECT_EQ(cache.Find(L"https://example.com/icon.png")->etag, L"\"2\"");
+	EXPECT_EQ(std::distance(std::filesystem::directory_iterator(m_directory / "index"), {}), 1);
+
+	cache.Remove(L"https://example.com/icon.png");
+	EXPECT_FALSE(cache.Find(L"https://example.com/icon.png"));
+}
+
+TEST_F(HttpCacheTest, CacheControl)
+{
+	auto now = std::chrono::system_clock::time_point(std::chrono::seconds(1000));
+
+	EXPECT_EQ(HttpCache::Expires(L"public, max-age=300", now), 1300);
+	EXPECT_EQ(HttpCache::Expires(L"Max-Age=60", now), 1060);
+	EXPECT_EQ(HttpCache::Expires(L"no-cache, max-age=300", now), 1000);
+	EXPECT_EQ(HttpCache::Expires(L"", now), 1000);
+
+	EXPECT_TRUE(HttpCache::NoStore(L"private, no-store"));
+	EXPECT_FALSE(HttpCache::NoStore(L"no-cache"));
+
+	HttpCacheEntry entry;
+	entry.expires = 1300;
+	EXPECT_TRUE(entry.Fresh(now));
+	EXPECT_FALSE(entry.Fresh(now + std::chrono::seconds(300)));
+}
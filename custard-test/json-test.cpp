@@ -1,5 +1,11 @@
 #include "pch.h"
 #include <json.h>
+#include <jsonlines.h>
+#include <jsonsax.h>
+#include <jsonschema.h>
+#include <jsonstream.h>
+#include <jsontape.h>
+#include <jsonwriter.h>
 #include <optional>
 
 using namespace custard;
@@ -275,3 +281,808 @@ TEST(ParseJsonTest, ResponseType2)
 	EXPECT_STREQ(response.message.botProfile.icons.image48.c_str(), L"https://a.slack-edge.com/hoge/img/plugins/app/bot_48.png");
 	EXPECT_STREQ(response.message.botProfile.icons.image72.c_str(), L"https://a.slack-edge.com/hoge/img/plugins/app/service_72.png");
 }
+
+TEST(ParseJsonTest, LongTokens)
+{
+	std::wstring padding(70, L' ');
+	std::wstring value(100, L'x');
+	std::wstring text = L"{" + padding + L"\"key\"\t:\r\n" + padding + L"\"" + value + L"\\\"" + value + L"\"" + padding + L",\"number\":" + value + L"}";
+
+	auto json = Json(text);
+
+	EXPECT_EQ(Json::State::Object, std::get<Json::State>(json.Parse()));
+
+	auto [key1, val1] = std::get<std::pair<std::wstring, Json>>(json.Parse());
+	EXPECT_STREQ(key1.c_str(), L"key");
+	EXPECT_STREQ(val1.GetString().c_str(), (value + L"\"" + value).c_str());
+
+	auto [key2, val2] = std::get<std::pair<std::wstring, Json>>(json.Parse());
+	EXPECT_STREQ(key2.c_str(), L"number");
+	EXPECT_STREQ(val2.GetString().c_str(), value.c_str());
+
+	EXPECT_EQ(Json::State::End, std::get<Json::State>(json.Parse()));
+}
+
+TEST(ParseJsonTest, Utf8Text)
+{
+	auto json = Json(u8"{\"text\": \"V\", \"raw\": \"`\U0001F600\"}");
+
+	EXPECT_EQ(Json::State::Object, std::get<Json::State>(json.Parse()));
+
+	auto [key1, val1] = std::get<std::pair<std::wstring, Json>>(json.Parse());
+	EXPECT_STREQ(key1.c_str(), L"text");
+	EXPECT_STREQ(val1.GetString().c_str(), L"V");
+
+	auto [key2, val2] = std::get<std::pair<std::wstring, Json>>(json.Parse());
+	EXPECT_STREQ(key2.c_str(), L"raw");
+	EXPECT_STREQ(val2.GetString().c_str(), L"`\U0001F600");
+
+	EXPECT_EQ(Json::State::End, std::get<Json::State>(json.Parse()));
+}
+
+TEST(ParseJsonTest, Utf8Bytes)
+{
+	std::string_view text = "\xEF\xBB\xBF{\"ok\":false,\"error\":\"not_in_channel\",\"response_metadata\":{\"warnings\":[\"superfluous_charset\"]}}";
+	auto json = Json(std::as_bytes(std::span(text)));
+
+	ResponseType1 response;
+	VisitJson(response, json);
+
+	EXPECT_FALSE(response.ok.value());
+	EXPECT_STREQ(response.error.c_str(), L"not_in_channel");
+
+	ASSERT_FALSE(response.metadata.warnings.empty());
+	EXPECT_STREQ(response.metadata.warnings[0].c_str(), L"superfluous_charset");
+}
+
+TEST(ParseJsonTest, ParseView)
+{
+	std::wstring_view text = LR"({"key": "value", "escaped": "a\"b"})";
+	auto json = Json(text);
+
+	EXPECT_EQ(Json::State::Object, std::get<Json::State>(json.ParseView()));
+
+	auto [key1, val1] = std::get<std::pair<JsonString, Json>>(json.ParseView());
+	EXPECT_TRUE(key1 == L"key");
+	EXPECT_EQ(text.data() + 2, key1.View().data());
+
+	auto value1 = std::get<JsonString>(val1.ParseView());
+	EXPECT_EQ(text.data() + 9, value1.View().data());
+	EXPECT_EQ(L"value", value1.View());
+
+	auto [key2, val2] = std::get<std::pair<JsonString, Json>>(json.ParseView());
+	EXPECT_TRUE(key2.starts_with(L"esc"));
+	EXPECT_FALSE(key2 == L"esc");
+
+	auto value2 = std::get<JsonString>(val2.ParseView());
+	EXPECT_TRUE(value2 == L"a\"b");
+	EXPECT_EQ(L"a\"b", value2.View());
+
+	EXPECT_EQ(Json::State::End, std::get<Json::State>(json.ParseView()));
+}
+
+TEST(ParseJsonTest, Utf8ParseView)
+{
+	auto json = Json(u8"{\"V\": \"\", \"caf\u00E9\": 1}");
+
+	EXPECT_EQ(Json::State::Object, std::get<Json::State>(json.ParseView()));
+
+	auto [key1, val1] = std::get<std::pair<JsonString, Json>>(json.ParseView());
+	EXPECT_TRUE(key1 == L"V");
+	EXPECT_TRUE(std::get<JsonString>(val1.ParseView()) == L"");
+
+	auto [key2, val2] = std::get<std::pair<JsonString, Json>>(json.ParseView());
+	EXPECT_TRUE(key2 == L"caf\u00E9");
+	EXPECT_FALSE(key2 == L"cafe");
+	EXPECT_EQ(1, std::get<JsonNumber>(val2.ParseView()).Int64());
+
+	EXPECT_EQ(Json::State::End, std::get<Json::State>(json.ParseView()));
+}
+
+// Kept out of line: GCC inlines the free() below into each delete expression and then warns that it
+// frees memory from operator new.
+#if defined(_MSC_VER)
+#define NOINLINE __declspec(noinline)
+#else
+#define NOINLINE __attribute__((noinline))
+#endif
+
+static size_t s_allocations = 0;
+
+NOINLINE void * operator new(size_t size)
+{
+	++s_allocations;
+
+	if (auto ptr = std::malloc(size ? size : 1))
+	{
+		return ptr;
+	}
+
+	throw std::bad_alloc();
+}
+
+NOINLINE void operator delete(void * ptr) noexcept
+{
+	std::free(ptr);
+}
+
+NOINLINE void operator delete(void * ptr, size_t) noexcept
+{
+	std::free(ptr);
+}
+
+struct ResponseType3
+{
+	std::optional<bool> ok;
+	size_t count = 0;
+
+	void operator()(JsonString && key, Json && value)
+	{
+		if (key == L"ok")
+		{
+			ok = value.GetBool();
+		}
+
+		++count;
+	}
+};
+
+TEST(ParseJsonTest, NoAllocation)
+{
+	std::string_view text = R"({"ok":true,"channel":"C123ABC456","ts":"1503435956.000247","message":{"text":"Here's a message for you","type":"message","bot_profile":{"icons":{"image_36":"https:\/\/a.slack-edge.com\/bot_36.png"}},"blocks":[[[[[[[[[[[[[[[[[[[[[[[[[[[[[["deep"]]]]]]]]]]]]]]]]]]]]]]]]]]]]]]}})";
+
+	JsonContext context(std::as_bytes(std::span(text)));
+	ResponseType3 response;
+
+	auto allocations = s_allocations;
+	Json json(context);
+	VisitJson(response, json);
+	EXPECT_EQ(allocations, s_allocations);
+
+	EXPECT_TRUE(response.ok.value());
+	EXPECT_EQ(4, response.count);
+}
+
+TEST(ParseJsonTest, MaxDepth)
+{
+	JsonContext context(LR"([[["too deep"]]])", 2);
+	Json json(context);
+
+	EXPECT_EQ(Json::State::Array, std::get<Json::State>(json.Parse()));
+	EXPECT_EQ(Json::State::Array, std::get<Json::State>(json.Parse()));
+	EXPECT_ANY_THROW(json.Parse());
+}
+
+TEST(ParseJsonTest, DeepNesting)
+{
+	std::wstring text = std::wstring(40, L'[') + L"\"deep\"" + std::wstring(40, L']');
+	auto json = Json(text);
+
+	for (int i = 0; i < 40; ++i)
+	{
+		EXPECT_EQ(Json::State::Array, std::get<Json::State>(json.Parse()));
+	}
+
+	EXPECT_STREQ(json.GetString().c_str(), L"deep");
+
+	for (int i = 1; i < 40; ++i)
+	{
+		EXPECT_EQ(Json::State::Next, std::get<Json::State>(json.Parse()));
+	}
+
+	EXPECT_EQ(Json::State::End, std::get<Json::State>(json.Parse()));
+}
+
+TEST(ParseJsonTest, Skip)
+{
+	auto json = Json(LR"({"skip": {"a": [1, "]}\"", {"b": "}"}]}, "partial": [[1], [2]], "scalar": "x", "next": "value"})");
+
+	EXPECT_EQ(Json::State::Object, std::get<Json::State>(json.Parse()));
+
+	auto [key1, val1] = std::get<std::pair<std::wstring, Json>>(json.Parse());
+	EXPECT_STREQ(key1.c_str(), L"skip");
+	val1.Skip();
+
+	auto [key2, val2] = std::get<std::pair<std::wstring, Json>>(json.Parse());
+	EXPECT_STREQ(key2.c_str(), L"partial");
+	EXPECT_EQ(Json::State::Array, std::get<Json::State>(val2.Parse()));
+	EXPECT_EQ(Json::State::Array, std::get<Json::State>(val2.Parse()));
+	val2.Skip();
+
+	auto [key3, val3] = std::get<std::pair<std::wstring, Json>>(json.Parse());
+	EXPECT_STREQ(key3.c_str(), L"scalar");
+	EXPECT_STREQ(val3.GetString().c_str(), L"x");
+	val3.Skip();
+
+	auto [key4, val4] = std::get<std::pair<std::wstring, Json>>(json.Parse());
+	EXPECT_STREQ(key4.c_str(), L"next");
+	EXPECT_STREQ(val4.GetString().c_str(), L"value");
+
+	EXPECT_EQ(Json::State::End, std::get<Json::State>(json.Parse()));
+
+	// Levels that never close are an error, not the rest of the document.
+	EXPECT_THROW(Json(L"[1, [2, \"]\"").Skip(), std::invalid_argument);
+	EXPECT_THROW(Json(std::u8string(u8"{\"a\": [") + std::u8string(100, u8'[')).Skip(), std::invalid_argument);
+
+	auto open = Json(L"[[1, 2");
+	EXPECT_EQ(Json::State::Array, std::get<Json::State>(open.Parse()));
+	EXPECT_EQ(Json::State::Array, std::get<Json::State>(open.Parse()));
+	EXPECT_THROW(open.Skip(), std::invalid_argument);
+}
+
+static std::vector<std::wstring> PullEvents(std::u8string_view text)
+{
+	std::vector<std::wstring> events;
+	auto json = Json(text);
+
+	for (;;)
+	{
+		auto value = json.ParseView();
+
+		if (auto state = std::get_if<Json::State>(&value))
+		{
+			events.push_back(std::to_wstring(*state));
+
+			if (*state == Json::State::End)
+				return events;
+		}
+		else if (auto keyValue = std::get_if<std::pair<JsonString, Json>>(&value))
+		{
+			events.push_back(L"key:" + keyValue->first.Str());
+		}
+		else if (auto number = std::get_if<JsonNumber>(&value))
+		{
+			events.push_back(L"num:" + number->Str());
+		}
+		else
+		{
+			events.push_back(L"str:" + std::get<JsonString>(value).Str());
+		}
+	}
+}
+
+static std::vector<std::wstring> PushEvents(std::u8string_view text, std::initializer_list<size_t> splits)
+{
+	std::vector<std::wstring> events;
+	JsonStream stream([&](JsonStream::Event && event)
+	{
+		if (auto state = std::get_if<Json::State>(&event))
+			events.push_back(std::to_wstring(*state));
+		else if (auto key = std::get_if<JsonStream::Key>(&event))
+			events.push_back(L"key:" + key->name.Str());
+		else if (auto number = std::get_if<JsonNumber>(&event))
+			events.push_back(L"num:" + number->Str());
+		else
+			events.push_back(L"str:" + std::get<JsonString>(event).Str());
+	});
+
+	auto data = (const std::byte *) text.data();
+	size_t offset = 0;
+
+	for (auto split : splits)
+	{
+		stream.Feed(data + offset, split - offset);
+		offset = split;
+	}
+
+	stream.Feed(data + offset, text.size() - offset);
+	stream.Finish();
+
+	return events;
+}
+
+TEST(ParseJsonTest, StreamChunks)
+{
+	std::u8string_view text = u8"{\"ok\": true, \"V\": \"\\u3042\\\"\", \"list\": [1, -2.5e3, null, [], {}], \"nested\": {\"a\": [\"\\\\\"]}}";
+	auto expected = PullEvents(text);
+
+	for (size_t i = 0; i <= text.size(); i++)
+	{
+		EXPECT_EQ(expected, PushEvents(text, { i })) << i;
+	}
+
+	std::vector<std::wstring> bytes;
+	JsonStream stream([&](JsonStream::Event && event)
+	{
+		if (auto state = std::get_if<Json::State>(&event))
+			bytes.push_back(std::to_wstring(*state));
+		else if (auto key = std::get_if<JsonStream::Key>(&event))
+			bytes.push_back(L"key:" + key->name.Str());
+		else if (auto number = std::get_if<JsonNumber>(&event))
+			bytes.push_back(L"num:" + number->Str());
+		else
+			bytes.push_back(L"str:" + std::get<JsonString>(event).Str());
+	});
+
+	for (auto & ch : text)
+	{
+		stream((std::byte *) &ch, 1);
+	}
+
+	stream.Finish();
+	EXPECT_EQ(expected, bytes);
+}
+
+TEST(ParseJsonTest, StreamErrors)
+{
+	auto feed = [](std::u8string_view text)
+	{
+		JsonStream stream([](JsonStream::Event &&) {});
+		stream.Feed((const std::byte *) text.data(), text.size());
+		stream.Finish();
+	};
+
+	EXPECT_NO_THROW(feed(u8"[1, 2] {\"a\": \"b\"}"));
+	EXPECT_THROW(feed(u8"{\"a\": [1, 2}"), std::invalid_argument);
+	EXPECT_THROW(feed(u8"{\"a\" 1}"), std::invalid_argument);
+	EXPECT_THROW(feed(u8"{\"a\": \"b"), std::invalid_argument);
+	EXPECT_THROW(feed(u8"[1, 2"), std::invalid_argument);
+}
+
+struct SchemaUser
+{
+	std::wstring name;
+	std::optional<bool> admin;
+
+	struct Profile
+	{
+		std::wstring title;
+		bool bot = false;
+
+	} profile;
+};
+
+template <>
+struct custard::JsonSchema<SchemaUser>
+{
+	static constexpr auto Fields = std::make_tuple(
+		JsonField(L"name", &SchemaUser::name),
+		JsonField(L"admin", &SchemaUser::admin),
+		JsonField(L"profile", &SchemaUser::profile));
+};
+
+template <>
+struct custard::JsonSchema<SchemaUser::Profile>
+{
+	static constexpr auto Fields = std::make_tuple(
+		JsonField(L"title", &SchemaUser::Profile::title),
+		JsonField(L"bot", &SchemaUser::Profile::bot));
+};
+
+TEST(ParseJsonTest, Schema)
+{
+	SchemaUser user;
+	auto json = Json(LR"({"id": 1, "name": "[U[", "profile": {"title": "x", "extra": {"title": "y"}, "bot": true}, "title": "z"})");
+
+	BindJson(user, json);
+
+	EXPECT_STREQ(user.name.c_str(), L"[U[");
+	EXPECT_FALSE(user.admin.has_value());
+	EXPECT_STREQ(user.profile.title.c_str(), L"x");
+	EXPECT_TRUE(user.profile.bot);
+}
+
+TEST(ParseJsonTest, Utf8Schema)
+{
+	SchemaUser user;
+	auto json = Json(u8"{\"admin\": false, \"n\\u0061me\": \"[U[\", \"nam\": \"\", \"names\": \"\"}");
+
+	BindJson(user, json);
+
+	EXPECT_STREQ(user.name.c_str(), L"[U[");
+	EXPECT_EQ(std::optional<bool>(false), user.admin);
+}
+
+struct SchemaOuter
+{
+	SchemaUser::Profile inner;
+	std::optional<SchemaUser::Profile> maybe;
+	std::wstring after;
+	bool ok = false;
+};
+
+template <>
+struct custard::JsonSchema<SchemaOuter>
+{
+	static constexpr auto Fields = std::make_tuple(
+		JsonField(L"inner", &SchemaOuter::inner),
+		JsonField(L"maybe", &SchemaOuter::maybe),
+		JsonField(L"after", &SchemaOuter::after),
+		JsonField(L"ok", &SchemaOuter::ok));
+};
+
+TEST(ParseJsonTest, SchemaNotAnObject)
+{
+	for (auto text : {
+		LR"({"inner": null, "maybe": null, "after": "a", "ok": true})",
+		LR"({"maybe": "str", "inner": {"title": "t"}, "after": "a", "ok": true})",
+		LR"({"maybe": [1, {"after": "b"}], "after": "a", "ok": true})",
+		LR"({"maybe": 2.5, "after": "a", "ok": true, "inner": null})" })
+	{
+		SchemaOuter outer;
+		auto json = Json(text);
+		BindJson(outer, json);
+
+		EXPECT_FALSE(outer.maybe.has_value());
+		EXPECT_EQ(outer.after, L"a");
+		EXPECT_TRUE(outer.ok);
+	}
+
+	// A member that is not optional must be an object or null.
+	SchemaOuter outer;
+	auto scalar = Json(LR"({"inner": "str", "after": "a", "ok": true})");
+	EXPECT_THROW(BindJson(outer, scalar), std::invalid_argument);
+
+	auto array = Json(LR"({"inner": [1], "after": "a", "ok": true})");
+	EXPECT_THROW(BindJson(outer, array), std::invalid_argument);
+
+	auto object = Json(LR"({"maybe": {"title": "t", "bot": true}, "after": "a"})");
+	BindJson(outer, object);
+	ASSERT_TRUE(outer.maybe.has_value());
+	EXPECT_EQ(outer.maybe->title, L"t");
+	EXPECT_TRUE(outer.maybe->bot);
+}
+
+TEST(ParseJsonTest, Numbers)
+{
+	auto json = Json(LR"([0, -12, 1234567890123456789, -9223372036854775808, 3.25, -1.5e-3, 1E+2, 0.1, 123456789012345678901234.5e-4, "1503435956.000247", true])");
+
+	EXPECT_EQ(Json::State::Array, std::get<Json::State>(json.Parse()));
+	EXPECT_EQ(0, json.GetInt64());
+	EXPECT_EQ(-12, json.GetInt64());
+	EXPECT_EQ(1234567890123456789, json.GetInt64());
+	EXPECT_EQ(INT64_MIN, json.GetInt64());
+	EXPECT_EQ(3.25, json.GetDouble());
+	EXPECT_EQ(-1.5e-3, json.GetDouble());
+	EXPECT_EQ(100.0, json.GetDouble());
+	EXPECT_EQ(0.1, json.GetDouble());
+	EXPECT_EQ(123456789012345678901234.5e-4, json.GetDouble());
+	EXPECT_EQ(1503435956.000247, json.GetDouble());
+	EXPECT_THROW(json.GetInt64(), std::invalid_argument);
+	EXPECT_EQ(Json::State::End, std::get<Json::State>(json.Parse()));
+
+	EXPECT_THROW(Json(L"9223372036854775808").GetInt64(), std::out_of_range);
+	EXPECT_THROW(Json(L"1.5").GetInt64(), std::invalid_argument);
+	EXPECT_THROW(Json(L"01").GetInt64(), std::invalid_argument);
+	EXPECT_THROW(Json(L"-").GetDouble(), std::invalid_argument);
+	EXPECT_THROW(Json(L"1e").GetDouble(), std::invalid_argument);
+	EXPECT_EQ(12345678, Json(u8"12345678").GetInt64());
+	EXPECT_EQ(-0.0001234567, Json(u8"-0.0001234567").GetDouble());
+}
+
+TEST(ParseJsonTest, NumberAsString)
+{
+	EXPECT_EQ(Json(L"42").GetString(), L"42");
+	EXPECT_EQ(Json(u8"-1.5e-3").GetString(), L"-1.5e-3");
+
+	auto json = Json(LR"({"a": 1.5})");
+	EXPECT_EQ(Json::State::Object, std::get<Json::State>(json.Parse()));
+
+	auto [key, val] = std::get<std::pair<std::wstring, Json>>(json.Parse());
+	EXPECT_EQ(val.GetString(), L"1.5");
+	EXPECT_EQ(Json::State::End, std::get<Json::State>(json.Parse()));
+}
+
+TEST(ParseJsonTest, Writer)
+{
+	std::wstring text = L"s\n\t\"p\" \\ \x01 \U0001F600 " + std::wstring(40, L'x');
+
+	JsonWriter writer;
+	writer.BeginObject()
+		.Key(L"text").String(text)
+		.Key(u8"list").BeginArray().Number((int64_t) -42).Number(0.1).Bool(true).Null().BeginObject().EndObject().EndArray()
+		.Key(L"utf8").String(u8"[U[")
+		.EndObject();
+
+	EXPECT_TRUE(u8"{\"text\":\"s\\n\\t\\\"p\\\" \\\\ \\u0001 \U0001F600 " + std::u8string(40, u8'x') + u8"\",\"list\":[-42,0.1,true,null,{}],\"utf8\":\"[U[\"}" == writer.View());
+
+	auto json = Json(writer.Bytes());
+	EXPECT_EQ(Json::State::Object, std::get<Json::State>(json.Parse()));
+
+	auto [key1, val1] = std::get<std::pair<std::wstring, Json>>(json.Parse());
+	EXPECT_EQ(text, val1.GetString());
+
+	writer.Clear();
+	writer.BeginArray().String(L"").EndArray();
+	EXPECT_TRUE(u8"[\"\"]" == writer.View());
+}
+
+TEST(ParseJsonTest, Tape)
+{
+	std::u8string_view text = u8"{\"ok\": true, \"list\": [1, {\"a\": [[], {}]}, \"x\\\"y\", null], \"bot\": {\"name\": \"{bg\", \"icons\": {\"image_48\": \"https://example.com/48.png\"}}, \"count\": 42}";
+	JsonTape tape(text);
+
+	auto root = tape.Root();
+	EXPECT_EQ(JsonTape::Kind::Object, root.Type());
+	EXPECT_TRUE(root[L"ok"].GetBool());
+	EXPECT_FALSE(root[L"error"]);
+	EXPECT_TRUE(root[L"bot"][L"icons"][L"image_48"].GetString() == L"https://example.com/48.png");
+	EXPECT_TRUE(root[L"bot"][L"name"].GetString() == L"{bg");
+	EXPECT_EQ(42, root[L"count"].GetNumber().Int64());
+
+	// Siblings skip whole values.
+	auto list = root[L"list"];
+	EXPECT_EQ(1, list[0].GetNumber().Int64());
+	EXPECT_EQ(JsonTape::Kind::Object, list[1].Type());
+	EXPECT_EQ(L"x\"y", list[2].GetString().Str());
+	EXPECT_TRUE(list[3].IsNull());
+	EXPECT_FALSE(list[4]);
+
+	std::vector<std::wstring> keys;
+
+	for (int i = 0; i < 2; i++)
+	{
+		for (auto node = root.First(); node; node = node.Next())
+		{
+			keys.push_back(node.GetString().Str());
+		}
+	}
+
+	EXPECT_EQ((std::vector<std::wstring>{ L"ok", L"list", L"bot", L"count", L"ok", L"list", L"bot", L"count" }), keys);
+
+	EXPECT_EQ(JsonTape::Kind::Array, JsonTape(L"[]").Root().Type());
+	EXPECT_FALSE(JsonTape(L"[]").Root().First());
+
+	EXPECT_THROW(JsonTape(L"{\"a\" 1}"), std::invalid_argument);
+	EXPECT_THROW(JsonTape(L"[1, 2"), std::invalid_argument);
+	EXPECT_THROW(JsonTape(L"[1] 2"), std::invalid_argument);
+	EXPECT_THROW(JsonTape(L"[tru]"), std::invalid_argument);
+	EXPECT_THROW(JsonTape(L"[[[1]]]", 2), std::length_error);
+}
+
+TEST(ParseJsonTest, Find)
+{
+	std::wstring_view text = LR"({"ok": true, "skip": {"bot": {"icons": {}}}, "a/b": {"m~n": 1}, "bot": {"name": "x", "icons": {"image_36": "36", "image_48": "48"}}, "list": [{"x": 1}, [2], "three"]})";
+
+	EXPECT_STREQ(Json(text).Find(L"/bot/icons/image_48")->GetString().c_str(), L"48");
+	EXPECT_EQ(1, Json(text).Find(L"/a~1b/m~0n")->GetInt64());
+	EXPECT_STREQ(Json(text).Find(L"/list/2")->GetString().c_str(), L"three");
+	EXPECT_EQ(1, Json(text).Find(L"/list/0/x")->GetInt64());
+	EXPECT_FALSE(Json(text).Find(L"/list/3").has_value());
+	EXPECT_FALSE(Json(text).Find(L"/bot/icons/image_72").has_value());
+	EXPECT_FALSE(Json(text).Find(L"/ok/x").has_value());
+	EXPECT_THROW(Json(text).Find(L"bot"), std::invalid_argument);
+
+	auto json = Json(text);
+	auto root = json.Find(L"");
+	EXPECT_EQ(Json::State::Object, std::get<Json::State>(root->Parse()));
+
+	// A cursor found from a temporary takes over its context, and outlives it.
+	auto bot = Json(text).Find(L"/bot");
+	ASSERT_TRUE(bot.has_value());
+	EXPECT_EQ(Json::State::Object, std::get<Json::State>(bot->Parse()));
+	auto [key, name] = std::get<std::pair<std::wstring, Json>>(bot->Parse());
+	EXPECT_EQ(key, L"name");
+	EXPECT_EQ(name.GetString(), L"x");
+
+	std::vector<std::wstring> values(5);
+	JsonQuery query{ L"/bot/icons/image_48", L"/ok", L"/list/1/0", L"/bot/name", L"/missing" };
+
+	auto doc = Json(text);
+	query.Run(doc, [&](size_t i, Json & value)
+	{
+		auto token = value.ParseView();
+
+		if (auto number = std::get_if<JsonNumber>(&token))
+			values[i] = number->Str();
+		else
+			values[i] = std::get<JsonString>(token).Str();
+	});
+
+	EXPECT_EQ((std::vector<std::wstring>{ L"48", L"true", L"2", L"x", L"" }), values);
+
+	// Each value goes to one callback, so no pointer may cover another.
+	EXPECT_THROW((JsonQuery{ L"/bot", L"/bot/name" }), std::invalid_argument);
+	EXPECT_THROW((JsonQuery{ L"/bot/name", L"/bot" }), std::invalid_argument);
+	EXPECT_THROW((JsonQuery{ L"/ok", L"/ok" }), std::invalid_argument);
+	EXPECT_THROW((JsonQuery{ L"", L"/ok" }), std::invalid_argument);
+	EXPECT_NO_THROW((JsonQuery{ L"/bot/name", L"/bot/names", L"/bo" }));
+}
+
+struct SaxRecorder
+{
+	std::vector<std::wstring> events;
+
+	void OnBeginObject() { events.push_back(L"{"); }
+	void OnEndObject() { events.push_back(L"}"); }
+	void OnBeginArray() { events.push_back(L"["); }
+	void OnEndArray() { events.push_back(L"]"); }
+	void OnKey(JsonString && key) { events.push_back(L"key:" + key.Str()); }
+	void OnString(JsonString && value) { events.push_back(L"str:" + value.Str()); }
+	void OnNumber(JsonNumber && value) { events.push_back(L"num:" + value.Str()); }
+	void OnBool(bool value) { events.push_back(value ? L"true" : L"false"); }
+	void OnNull() { events.push_back(L"null"); }
+};
+
+struct SaxCounter
+{
+	size_t keys = 0;
+
+	void OnKey(JsonString &&) { ++keys; }
+};
+
+TEST(ParseJsonTest, Sax)
+{
+	std::vector<std::wstring> expected{ L"{", L"key:ok", L"true", L"key:V", L"str:\"", L"key:list", L"[", L"num:-1.5e3", L"null", L"[", L"]", L"{", L"}", L"false", L"]", L"}" };
+
+	SaxRecorder wide;
+	ParseJson(std::wstring_view(LR"({"ok": true, "V": "\"", "list": [-1.5e3, null, [], {}, false]})"), wide);
+	EXPECT_EQ(expected, wide.events);
+
+	SaxRecorder utf8;
+	ParseJson(std::u8string_view(u8"{\"ok\":true,\"V\":\"\\\"\",\"list\":[-1.5e3,null,[],{},false]}"), utf8);
+	EXPECT_EQ(expected, utf8.events);
+
+	SaxCounter counter;
+	ParseJson(std::wstring_view(LR"({"a": {"b": 1, "c": [{"d": 2}]}})"), counter);
+	EXPECT_EQ(4, counter.keys);
+
+	EXPECT_THROW(ParseJson(std::wstring_view(L"{\"a\": [1}"), counter), std::invalid_argument);
+	EXPECT_THROW(ParseJson(std::wstring_view(L"[1, 2"), counter), std::invalid_argument);
+	EXPECT_THROW(ParseJson(std::wstring_view(L"[1] 2"), counter), std::invalid_argument);
+	EXPECT_THROW(ParseJson(std::wstring_view(L"[[[1]]]"), counter, 2), std::length_error);
+}
+
+TEST(ParseJsonTest, JsonLines)
+{
+	std::string text;
+
+	for (int i = 0; i < 1000; i++)
+	{
+		text += "{\"id\": " + std::to_string(i) + ", \"text\": \"line\\n\"}" + ((i % 3) ? "\n" : "\r\n\n");
+	}
+
+	auto data = std::as_bytes(std::span(text));
+	EXPECT_EQ(1000, SplitJsonLines(data).size());
+
+	auto ids = ParseJsonLines(data, [](Json & json)
+	{
+		return json.Find(L"/id")->GetInt64();
+	},
+	4);
+
+	ASSERT_EQ(1000, ids.size());
+
+	for (int64_t i = 0; i < 1000; i++)
+	{
+		EXPECT_EQ(i, ids[i]);
+	}
+
+	// A malformed line, missing its colon, stops the parse with the parser's own error.
+	text += "{\"id\" 1000}\n";
+	EXPECT_THROW(ParseJsonLines(std::as_bytes(std::span(text)), [](Json & json) { return json.Find(L"/id")->GetInt64(); }, 4), std::invalid_argument);
+}
+
+struct ArenaUser
+{
+	std::wstring_view name;
+	std::wstring_view title;
+	int64_t id = 0;
+};
+
+template <>
+struct custard::JsonSchema<ArenaUser>
+{
+	static constexpr auto Fields = std::make_tuple(
+		JsonField(L"name", &ArenaUser::name),
+		JsonField(L"title", &ArenaUser::title),
+		JsonField(L"id", &ArenaUser::id));
+};
+
+TEST(ParseJsonTest, Arena)
+{
+	std::string text = R"({"deep": )" + std::string(40, '[') + std::string(40, ']') + R"(, "name": "[U[", "title": "a\"b", "id": 7})";
+
+	std::byte buffer[4096];
+	std::pmr::monotonic_buffer_resource arena(buffer, sizeof(buffer), std::pmr::null_memory_resource());
+
+	ArenaUser user;
+	s_allocations = 0;
+	{
+		JsonContext context(std::as_bytes(std::span(text)), JsonStack::DefaultMaxDepth, &arena);
+		Json json(context);
+		BindJson(user, json);
+	}
+	EXPECT_EQ(0, s_allocations);
+
+	EXPECT_EQ(L"[U[", user.name);
+	EXPECT_EQ(L"a\"b", user.title);
+	EXPECT_EQ(7, user.id);
+
+	EXPECT_GE((const std::byte *) user.name.data(), buffer);
+	EXPECT_LT((const std::byte *) user.name.data(), buffer + sizeof(buffer));
+}
+
+TEST(ParseJsonTest, SurrogatePairs)
+{
+	// U+1F600 as an escaped pair, a lone high surrogate and a lone low surrogate, in both source forms
+	auto wide = Json(LR"(["\ud83d\ude00 ok", "\uD83Dx", "\uDE00", "\\u0041\u00e9\/"])");
+	auto utf8 = Json(u8R"(["\ud83d\ude00 ok", "\uD83Dx", "\uDE00", "\\u0041\u00e9\/"])");
+
+	for (auto json : { &wide, &utf8 })
+	{
+		EXPECT_EQ(Json::State::Array, std::get<Json::State>(json->ParseView()));
+
+		auto emoji = std::get<JsonString>(json->ParseView());
+		EXPECT_EQ(L"\U0001F600 ok", emoji.Str());
+		EXPECT_TRUE(u8"\U0001F600 ok" == emoji.U8Str());
+		EXPECT_TRUE(emoji == L"\U0001F600 ok");
+		EXPECT_EQ(JsonHash(L"\U0001F600 ok", 5), emoji.Hash(5));
+
+		EXPECT_EQ(L"\uFFFDx", std::get<JsonString>(json->ParseView()).Str());
+		EXPECT_TRUE(u8"\uFFFD" == std::get<JsonString>(json->ParseView()).U8Str());
+
+		auto mixed = std::get<JsonString>(json->ParseView());
+		EXPECT_EQ(L"\\u0041\u00E9/", mixed.Str());
+		EXPECT_TRUE(u8"\\u0041\u00E9/" == mixed.U8Str());
+
+		EXPECT_EQ(Json::State::End, std::get<Json::State>(json->ParseView()));
+	}
+
+	EXPECT_THROW(Json(LR"("\u12G4")").GetString(), std::invalid_argument);
+}
+
+TEST(ParseJsonTest, Validate)
+{
+	EXPECT_FALSE(Json::Validate(std::wstring_view(LR"({"a": [1, "b\n", true, null, {}], "c": -0.5e+10, "d": false})")));
+	EXPECT_FALSE(Json::Validate(std::u8string_view(u8"[\"\\u3042\"]")));
+
+	struct Case
+	{
+		std::wstring_view text;
+		JsonErrc reason;
+		size_t offset;
+	};
+
+	for (auto & [text, reason, offset] : {
+		Case{ L"{\"a\" 1}", JsonErrc::UnexpectedCharacter, 5 },
+		Case{ L"[1, 2", JsonErrc::UnexpectedEnd, 5 },
+		Case{ L"[1] 2", JsonErrc::UnexpectedCharacter, 4 },
+		Case{ L"[1}", JsonErrc::UnexpectedCharacter, 2 },
+		Case{ L"[\"abc", JsonErrc::UnterminatedString, 5 },
+		Case{ L"[\"a\\x\"]", JsonErrc::InvalidEscape, 4 },
+		Case{ L"[\"\\u12G4\"]", JsonErrc::InvalidEscape, 6 },
+		Case{ L"[\"\\u12\"]", JsonErrc::InvalidEscape, 6 },
+		Case{ L"[\"\\u12", JsonErrc::UnterminatedString, 6 },
+		Case{ L"[1e]", JsonErrc::UnexpectedCharacter, 2 },
+		Case{ L"[-]", JsonErrc::UnexpectedCharacter, 1 },
+		Case{ L"[01]", JsonErrc::UnexpectedCharacter, 2 },
+		Case{ L"[1.2.3]", JsonErrc::UnexpectedCharacter, 4 },
+		Case{ L"[1.]", JsonErrc::UnexpectedCharacter, 2 },
+		Case{ L"[tru]", JsonErrc::UnexpectedCharacter, 1 },
+		Case{ L"[x]", JsonErrc::UnexpectedCharacter, 1 },
+		Case{ L"[[[1]]]", JsonErrc::TooDeep, 2 },
+		Case{ L"", JsonErrc::UnexpectedEnd, 0 } })
+	{
+		auto error = Json::Validate(text, 2);
+		EXPECT_TRUE(error.code == reason) << std::string(text.begin(), text.end()) << ": " << error.code.message();
+		EXPECT_EQ(offset, error.offset) << std::string(text.begin(), text.end());
+	}
+
+	// Byte offsets count the byte order mark.
+	std::string bytes = "\xEF\xBB\xBF[1,]";
+	auto error = Json::Validate(std::as_bytes(std::span(bytes)));
+	EXPECT_TRUE(error.code == JsonErrc::UnexpectedCharacter);
+	EXPECT_EQ(6, error.offset);
+}
+
+TEST(ParseJsonTest, SaxErrorCode)
+{
+	struct Counter
+	{
+		int values = 0;
+
+		void OnNumber(JsonNumber &&) { ++values; }
+	}
+	counter;
+
+	auto error = ParseJson(std::u8string_view(u8"[1, 2, 3 4]"), counter, std::nothrow);
+	EXPECT_TRUE(error.code == JsonErrc::UnexpectedCharacter);
+	EXPECT_EQ(9, error.offset);
+	EXPECT_EQ(3, counter.values);
+
+	EXPECT_FALSE(ParseJson(std::u8string_view(u8"[5]"), counter, std::nothrow));
+	EXPECT_EQ(4, counter.values);
+
+	EXPECT_THROW(ParseJson(std::u8string_view(u8"[\"\\q\"]"), counter), std::invalid_argument);
+}
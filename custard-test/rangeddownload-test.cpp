@@ -0,0 +1,99 @@
+#include "pch.h"
+#include <rangeddownload.h>
+
+#include <filesystem>
+
+using namespace custard;
+
+class RangedDownloadTest : public ::testing::Test
+{
+protected:
+	std::filesystem::path m_sidecar = std::filesystem::temp_directory_path() / "custard-test-ranged.part.json";
+
+	void SetUp() override
+	{
+		std::filesystem::remove(m_sidecar);
+	}
+
+	void TearDown() override
+	{
+		std::filesystem::remove(m_sidecar);
+	}
+};
+
+TEST_F(RangedDownloadTest, Split)
+{
+	const uint64_t length = 10 * RangedDownload::MinRangeSize + 3;
+
+	RangedDownload progress(m_sidecar, L"https://example.com/big.zip", L"\"v1\"", length, 4);
+	EXPECT_FALSE(progress.Resumed());
+
+	auto ranges = progress.Ranges();
+	ASSERT_EQ(ranges.size(), 4u);
+	EXPECT_EQ(ranges.front().begin, 0u);
+	EXPECT_EQ(ranges.back().end, length);
+
+	for (size_t i = 1; i < ranges.size(); ++i)
+	{
+		EXPECT_EQ(ranges[i - 1].end, ranges[i].begin);
+	}
+
+	// No range is made smaller than MinRangeSize.
+	RangedDownload small(m_sidecar, L"https://example.com/small.zip", L"", RangedDownload::MinRangeSize + 1, 4);
+	EXPECT_EQ(small.Ranges().size(), 2u);
+}
+
+TEST_F(RangedDownloadTest, Resume)
+{
+	const uint64_t length = 4 * RangedDownload::MinRangeSize;
+	{
+		RangedDownload progress(m_sidecar, L"https://example.com/big.zip", L"\"v1\"", length, 4);
+		progress.Advance(1, 100);
+		progress.Advance(3, RangedDownload::MinRangeSize);
+		progress.Save();
+	}
+
+	RangedDownload progress(m_sidecar, L"https://example.com/big.zip", L"\"v1\"", length, 2);
+	EXPECT_TRUE(progress.Resumed());
+
+	auto ranges = progress.Ranges();
+	ASSERT_EQ(ranges.size(), 4u);
+	EXPECT_EQ(ranges[0].Next(), 0u);
+	EXPECT_EQ(ranges[1].Next(), RangedDownload::MinRangeSize + 100);
+	EXPECT_FALSE(ranges[1].Complete());
+	EXPECT_TRUE(ranges[3].Complete());
+
+	progress.Remove();
+	EXPECT_FALSE(std::filesystem::exists(m_sidecar));
+}
+
+TEST_F(RangedDownloadTest, ChangedFileStartsOver)
+{
+	const uint64_t length = 4 * RangedDownload::MinRangeSize;
+	{
+		RangedDownload progress(m_sidecar, L"https://example.com/big.zip", L"\"v1\"", length, 4);
+		progress.Advance(0, 100);
+		progress.Save();
+	}
+
+	RangedDownload changed(m_sidecar, L"https://example.com/big.zip", L"\"v2\"", length, 4);
+	EXPECT_FALSE(changed.Resumed());
+	EXPECT_EQ(changed.Ranges()[0].done, 0u);
+
+	RangedDownload resized(m_sidecar, L"https://example.com/big.zip", L"\"v1\"", length + 1, 4);
+	EXPECT_FALSE(resized.Resumed());
+}
+
+TEST_F(RangedDownloadTest, NoValidatorStartsOver)
+{
+	const uint64_t length = 4 * RangedDownload::MinRangeSize;
+	{
+		RangedDownload progress(m_sidecar, L"https://example.com/big.zip", L"", length, 4);
+		progress.Advance(0, 100);
+		progress.Save();
+	}
+
+	RangedDownload progress(m_sidecar, L"https://example.com/big.zip", L"", length, 4);
+	EXPECT_FALSE(progress.Resumed());
+	EXPECT_EQ(progress.Ranges()[0].done, 0u);
+}
@@ -0,0 +1,107 @@
+#include "pch.h"
+#include <jsonstream.h>
+#include <segmentedbuffer.h>
+
+#include <string>
+#include <vector>
+
+using namespace custard;
+
+static std::vector<std::byte> Pattern(size_t size)
+{
+	std::vector<std::byte> data(size);
+
+	for (size_t i = 0; i < size; ++i)
+	{
+		data[i] = (std::byte) (i * 7 + i / 251);
+	}
+
+	return data;
+}
+
+TEST(SegmentedBufferTest, Chunks)
+{
+	auto data = Pattern(ChunkPool::ChunkSize * 2 + 100);
+
+	SegmentedBuffer buffer;
+	buffer.Append(data);
+
+	std::vector<size_t> sizes;
+
+	for (auto chunk : buffer)
+	{
+		sizes.push_back(chunk.size());
+	}
+
+	EXPECT_EQ(sizes, (std::vector<size_t>{ ChunkPool::ChunkSize, ChunkPool::ChunkSize, 100 }));
+	EXPECT_EQ(buffer.size(), data.size());
+	EXPECT_EQ(buffer.ToVector(), data);
+
+	auto joined = buffer.Contiguous();
+	EXPECT_TRUE(std::equal(joined.begin(), joined.end(), data.begin(), data.end()));
+}
+
+TEST(SegmentedBufferTest, PrepareCommit)
+{
+	SegmentedBuffer buffer;
+	EXPECT_TRUE(buffer.empty());
+	EXPECT_EQ(buffer.begin(), buffer.end());
+	EXPECT_TRUE(buffer.Contiguous().empty());
+
+	auto space = buffer.Prepare();
+	ASSERT_EQ(space.size(), ChunkPool::ChunkSize);
+	space[0] = std::byte{ 'a' };
+	space[1] = std::byte{ 'b' };
+	buffer.Commit(2);
+
+	EXPECT_EQ(buffer.Prepare().size(), ChunkPool::ChunkSize - 2);
+
+	// A body that fits in one chunk is handed out in place.
+	auto contiguous = buffer.Contiguous();
+	EXPECT_EQ(contiguous.data(), space.data());
+	EXPECT_EQ(contiguous.size(), 2u);
+}
+
+TEST(SegmentedBufferTest, PoolReuse)
+{
+	std::byte * block = nullptr;
+	{
+		SegmentedBuffer buffer;
+		block = buffer.Prepare().data();
+	}
+
+	SegmentedBuffer buffer;
+	EXPECT_EQ(buffer.Prepare().data(), block);
+}
+
+TEST(SegmentedBufferTest, StreamChunks)
+{
+	std::string text = "[";
+
+	while (text.size() < ChunkPool::ChunkSize * 3)
+	{
+		text += "\"abcdefghijklmnopqrstuvwxyz\",";
+	}
+
+	text += "1]";
+
+	SegmentedBuffer buffer;
+	buffer.Append({ (const std::byte *) text.data(), text.size() });
+
+	size_t strings = 0;
+	JsonStream stream([&strings](JsonStream::Event && event)
+	{
+		if (auto str = std::get_if<JsonString>(&event); str && *str == L"abcdefghijklmnopqrstuvwxyz")
+		{
+			++strings;
+		}
+	});
+
+	for (auto chunk : buffer)
+	{
+		stream.Feed(chunk.data(), chunk.size());
+	}
+
+	stream.Finish();
+	EXPECT_EQ(strings, (text.size() - 4) / 29 + 1);
+}
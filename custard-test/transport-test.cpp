@@ -0,0 +1,235 @@
+#include "pch.h"
+#include <sockettransport.h>
+#include <transport.h>
+
+#if defined(_WIN32)
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#include <atomic>
+#include <future>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace custard;
+
+static std::string ContentOf(const HttpResponse & response)
+{
+	return { (const char *) response.content.data(), response.content.size() };
+}
+
+TEST(HttpResponseReaderTest, ContentLength)
+{
+	std::string text = "HTTP/1.1 200 OK\r\nContent-Type: text/plain\r\nContent-Length: 5\r\n\r\nHello";
+
+	HttpResponseReader reader;
+	EXPECT_TRUE(reader.Feed(text.data(), text.size()));
+	EXPECT_TRUE(reader.KeepAlive());
+	EXPECT_EQ(reader.Result().status, 200u);
+	EXPECT_EQ(ContentOf(reader.Result()), "Hello");
+	EXPECT_EQ(reader.Result().Header(L"content-type"), L"text/plain");
+	EXPECT_EQ(reader.Result().Header(L"X-Missing"), L"");
+}
+
+TEST(HttpResponseReaderTest, ChunkedOneByteAtATime)
+{
+	std::string text = "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n5;ext=1\r\nHello\r\nb\r\n, chunked!!\r\n0\r\nX-Trailer: 1\r\n\r\n";
+
+	HttpResponseReader reader;
+
+	for (size_t i = 0; i + 1 < text.size(); ++i)
+	{
+		ASSERT_FALSE(reader.Feed(&text[i], 1)) << i;
+	}
+
+	EXPECT_TRUE(reader.Feed(&text.back(), 1));
+	EXPECT_EQ(ContentOf(reader.Result()), "Hello, chunked!!");
+}
+
+TEST(HttpResponseReaderTest, UntilClose)
+{
+	std::string text = "HTTP/1.0 200 OK\r\n\r\nuntil the end";
+
+	HttpResponseReader reader;
+	EXPECT_FALSE(reader.Feed(text.data(), text.size()));
+	EXPECT_TRUE(reader.Close());
+	EXPECT_FALSE(reader.KeepAlive());
+	EXPECT_EQ(ContentOf(reader.Result()), "until the end");
+}
+
+TEST(HttpResponseReaderTest, InterimAndTruncated)
+{
+	std::string text = "HTTP/1.1 100 Continue\r\n\r\nHTTP/1.1 404 Not Found\r\nContent-Length: 10\r\nConnection: close\r\n\r\nshort";
+
+	HttpResponseReader reader;
+	EXPECT_FALSE(reader.Feed(text.data(), text.size()));
+	EXPECT_EQ(reader.Result().status, 404u);
+	EXPECT_FALSE(reader.KeepAlive());
+	EXPECT_FALSE(reader.Close());
+}
+
+//
+// A plain HTTP server on a loopback port that answers every request on a connection with its path.
+//
+class EchoServer
+{
+#if defined(_WIN32)
+	using SocketHandle = SOCKET;
+	static void CloseSocket(SOCKET socket) { ::closesocket(socket); }
+
+	// The server may come up before any SocketTransport has started Winsock.
+	struct WinsockLibrary
+	{
+		int error;
+
+		WinsockLibrary()
+		{
+			WSADATA data{};
+			error = ::WSAStartup(MAKEWORD(2, 2), &data);
+		}
+
+		~WinsockLibrary() noexcept
+		{
+			if (!error)
+			{
+				::WSACleanup();
+			}
+		}
+	};
+#else
+	using SocketHandle = int;
+	static void CloseSocket(int socket) { ::close(socket); }
+#endif
+
+	SocketHandle m_listener = (SocketHandle) -1;
+	uint16_t m_port = 0;
+	std::atomic<int> m_connections{ 0 };
+	std::thread m_thread;
+	std::vector<std::thread> m_clients;
+
+public:
+	// Port() is 0 if the server could not listen, and the failure is reported to the test.
+	EchoServer()
+	{
+		Listen();
+
+		m_thread = std::thread([this]()
+		{
+			for (SocketHandle client; (client = ::accept(m_listener, nullptr, nullptr)) != (SocketHandle) -1;)
+			{
+				++m_connections;
+				m_clients.emplace_back(&EchoServer::Serve, client);
+			}
+		});
+	}
+
+	~EchoServer()
+	{
+#if defined(_WIN32)
+		CloseSocket(m_listener);
+#else
+		::shutdown(m_listener, SHUT_RDWR);
+		CloseSocket(m_listener);
+#endif
+		m_thread.join();
+
+		for (auto & client : m_clients)
+		{
+			client.join();
+		}
+	}
+
+	uint16_t Port() const noexcept
+	{
+		return m_port;
+	}
+
+	int Connections() const noexcept
+	{
+		return m_connections;
+	}
+
+private:
+	void Listen()
+	{
+#if defined(_WIN32)
+		static const WinsockLibrary library;
+		ASSERT_EQ(library.error, 0);
+#endif
+		sockaddr_in address{};
+		address.sin_family = AF_INET;
+		address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+		socklen_t length = sizeof(address);
+		m_listener = ::socket(AF_INET, SOCK_STREAM, 0);
+		ASSERT_NE(m_listener, (SocketHandle) -1);
+		ASSERT_EQ(::bind(m_listener, (sockaddr *) &address, length), 0);
+		ASSERT_EQ(::listen(m_listener, 64), 0);
+		ASSERT_EQ(::getsockname(m_listener, (sockaddr *) &address, &length), 0);
+		m_port = ntohs(address.sin_port);
+	}
+
+	static void Serve(SocketHandle client)
+	{
+		std::string input;
+		char buffer[4096];
+
+		for (int received; (received = (int) ::recv(client, buffer, sizeof(buffer), 0)) > 0;)
+		{
+			input.append(buffer, received);
+
+			for (auto end = input.find("\r\n\r\n"); end != std::string::npos; end = input.find("\r\n\r\n"))
+			{
+				auto path = input.substr(input.find(' ') + 1);
+				path = path.substr(0, path.find(' '));
+				input.erase(0, end + 4);
+
+				auto response = "HTTP/1.1 200 OK\r\nContent-Length: " + std::to_string(path.size()) + "\r\n\r\n" + path;
+				::send(client, response.data(), (int) response.size(), 0);
+			}
+		}
+
+		CloseSocket(client);
+	}
+};
+
+TEST(SocketTransportTest, ConcurrentRequests)
+{
+	EchoServer server;
+	ASSERT_NE(server.Port(), 0);
+	{
+		// The transport closes its idle sockets when it goes, and so must go before the server.
+		auto transport = std::make_shared<SocketTransport>();
+		HttpClient client(L"http://127.0.0.1:" + std::to_wstring(server.Port()), transport);
+		std::vector<std::future<HttpResponse>> responses;
+
+		for (int i = 0; i < 40; ++i)
+		{
+			responses.push_back(client.GetAsync(L"/api/" + std::to_wstring(i)));
+		}
+
+		for (int i = 0; i < 40; ++i)
+		{
+			auto response = responses[i].get();
+			EXPECT_EQ(response.status, 200u);
+			EXPECT_EQ(ContentOf(response), "/api/" + std::to_string(i));
+		}
+	}
+
+	EXPECT_LE(server.Connections(), (int) SocketTransport::MaxPerHost);
+}
+
+TEST(SocketTransportTest, Errors)
+{
+	auto transport = std::make_shared<SocketTransport>();
+
+	EXPECT_THROW(HttpClient(L"https://127.0.0.1:1", transport).GetAsync(L"/").get(), std::runtime_error);
+	EXPECT_THROW(HttpClient(L"http://127.0.0.1:1", transport).GetAsync(L"/").get(), std::system_error);
+	EXPECT_THROW(HttpClient(L"ftp://127.0.0.1", transport), std::runtime_error);
+}
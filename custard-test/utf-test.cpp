@@ -0,0 +1,54 @@
+#include "pch.h"
+#include <utf.h>
+
+using namespace custard;
+
+TEST(UtfTest, Ascii)
+{
+	// Longer than a block, so that both the block copier and the tail are used.
+	std::u8string utf8 = u8"The quick brown fox jumps over the lazy dog, 0123456789 times.";
+	std::wstring wstr = L"The quick brown fox jumps over the lazy dog, 0123456789 times.";
+
+	EXPECT_EQ(wstr, ConvertFrom(utf8));
+	EXPECT_TRUE(utf8 == ConvertFrom(wstr));
+}
+
+TEST(UtfTest, Empty)
+{
+	EXPECT_TRUE(ConvertFrom(std::wstring_view()).empty());
+	EXPECT_TRUE(ConvertFrom(std::u8string_view()).empty());
+}
+
+TEST(UtfTest, MixedWidths)
+{
+	// U+00A9, U+3042, U+1F600 between ASCII runs of varying length
+	std::u8string utf8 = u8"a\u00A9bc\u3042\u3042defghijklmnopqrstuvwxyz0123456789\U0001F600!";
+	std::wstring wstr = L"a\u00A9bc\u3042\u3042defghijklmnopqrstuvwxyz0123456789\U0001F600!";
+
+	EXPECT_EQ(wstr, ConvertFrom(utf8));
+	EXPECT_TRUE(utf8 == ConvertFrom(wstr));
+
+	// Starting in the middle of a sequence costs only replacement characters.
+	for (size_t i = 0; i < utf8.size(); i++)
+	{
+		auto suffix = ConvertFrom(std::u8string_view(utf8).substr(i));
+		EXPECT_TRUE(suffix.ends_with(L"!")) << i;
+	}
+}
+
+TEST(UtfTest, IllFormedUtf8)
+{
+	// Stray trail byte, overlong form, encoded surrogate, past U+10FFFF, truncated sequence
+	EXPECT_EQ(L"a\uFFFDb", ConvertFrom(std::u8string_view(u8"a\x80" u8"b")));
+	EXPECT_EQ(L"\uFFFD\uFFFD", ConvertFrom(std::u8string_view(u8"\xC0\xAF")));
+	EXPECT_EQ(L"\uFFFD\uFFFD\uFFFD", ConvertFrom(std::u8string_view(u8"\xED\xA0\x80")));
+	EXPECT_EQ(L"\uFFFD\uFFFD\uFFFD\uFFFD", ConvertFrom(std::u8string_view(u8"\xF4\x90\x80\x80")));
+	EXPECT_EQ(L"\uFFFDz", ConvertFrom(std::u8string_view(u8"\xE3\x81" u8"z")));
+}
+
+TEST(UtfTest, UnpairedSurrogate)
+{
+	std::wstring wstr = { L'a', (wchar_t) 0xD800, L'b', (wchar_t) 0xDC00 };
+
+	EXPECT_TRUE(u8"a\uFFFDb\uFFFD" == ConvertFrom(wstr));
+}
@@ -1,11 +1,15 @@
 #include <format>
 #include <optional>
 #include <functional>
+#include <memory_resource>
 #include <system_error>
 
 #include "custard.h"
 #include "https.h"
 #include "json.h"
+#include "jsonschema.h"
+#include "jsonwriter.h"
+#include "slackresponse.h"
 
 //
 // https://api.slack.com/tutorials/tracks/posting-messages-with-curl
@@ -13,82 +17,17 @@
 
 namespace custard
 {
-	struct SlackApiResponse
-	{
-		std::optional<bool> ok;
-
-		struct Bot
-		{
-			std::wstring name;
-
-			struct Icons
-			{
-				std::wstring image_36;
-				std::wstring image_48;
-				std::wstring image_76;
-
-				void operator()(std::wstring && key, Json && value)
-				{
-					if (key == L"image_36")
-					{
-						image_36 = value.GetString();
-						return;
-					}
-					if (key == L"image_48")
-					{
-						image_48 = value.GetString();
-						return;
-					}
-					if (key == L"image_76")
-					{
-						image_76 = value.GetString();
-						return;
-					}
-				}
-
-			} icons;
-
-			void operator()(std::wstring && key, Json && value)
-			{
-				if (key == L"name")
-				{
-					name = value.GetString();
-					return;
-				}
-				if (key == L"icons")
-				{
-					VisitJson(icons, value);
-					return;
-				}
-			}
-
-		} bot;
-
-		void operator()(std::wstring && key, Json && value)
-		{
-			if (key == L"ok")
-			{
-				ok = value.GetBool();
-				return;
-			}
-			if (key.starts_with(L"bot"))
-			{
-				VisitJson(bot, value);
-				return;
-			}
-		}
-	};
-
-
 	class SlackApi : Https
 	{
+		// Holds the strings of m_response until the next request.
+		std::pmr::monotonic_buffer_resource m_arena;
 		SlackApiResponse m_response;
 
 	public:
 		SlackApi(std::wstring_view token) : Https(L"slack.com")
 		{
 			SetBearerToken(token);
-			AddContentType(L"application/x-www-form-urlencoded");
+			AddContentType(L"application/json; charset=utf-8");
 		}
 
 		SlackApiResponse & Response()
@@ -102,10 +41,9 @@ namespace custard
 			return ParseResponse(response);
 		}
 
-		bool Post(const wchar_t * path, std::wstring_view form)
+		bool Post(const wchar_t * path, const JsonWriter & body)
 		{
-			auto content = ConvertFrom(form);
-			auto response = Https::Post(path, content.data(), (uint32_t) content.size());
+			auto response = Https::Post(path, body.Bytes());
 			return ParseResponse(response);
 		}
 
@@ -113,21 +51,31 @@ namespace custard
 		bool ParseResponse(custard::Response & response)
 		{
 			auto contentType = response.ContentType();
-			auto contentData = response.GetContent();
+			auto body = response.GetBody();
+			auto contentData = body.Contiguous();
 
 			if (contentType.starts_with(L"application/json"))
 			{
-				auto text = ConvertFrom(contentData);
-				auto json = Json(text);
+				m_response = {};
+				m_arena.release();
+
+				JsonContext context(contentData, JsonStack::DefaultMaxDepth, &m_arena);
+				Json json(context);
 
 #if defined(_DEBUG)
 				::OutputDebugStringW(L"=== Response ===\r\n");
 				::OutputDebugStringW(response.Headers().c_str());
-				::OutputDebugStringW(text.c_str());
+				::OutputDebugStringW(ConvertFrom(contentData).c_str());
 				::OutputDebugStringW(L"\r\n");
 				::OutputDebugStringW(L"================\r\n");
 #endif
-				VisitJson(m_response, json);
+				// A malformed body is rejected before any of it is bound.
+				if (auto error = Json::Validate(contentData))
+				{
+					throw std::system_error(error.code, "Invalid response at offset " + std::to_string(error.offset));
+				}
+
+				BindJson(m_response, json);
 
 				if (m_response.ok.has_value())
 				{
@@ -150,11 +98,15 @@ namespace custard
 
 	bool SlackBot::Post(std::wstring_view channel, std::wstring_view message)
 	{
-		if (m_api->Post(L"/api/chat.postMessage", std::format(L"channel={}&text={}", channel, message)))
+		JsonWriter body;
+		body.BeginObject().Key(L"channel").String(channel).Key(L"text").String(message).EndObject();
+
+		if (m_api->Post(L"/api/chat.postMessage", body))
 		{
 			if (m_name.empty() || m_icon.empty())
 			{
-				auto & bot = m_api->Response().bot;
+				auto & response = m_api->Response();
+				auto & bot = response.bot.name.empty() ? response.message.bot_profile : response.bot;
 				m_name = bot.name;
 				m_icon = DownloadIcon(bot.icons.image_48);
 			}
@@ -165,7 +117,7 @@ namespace custard
 		return false;
 	}
 
-	std::filesystem::path SlackBot::DownloadIcon(const std::wstring & url)
+	std::filesystem::path SlackBot::DownloadIcon(std::wstring_view url)
 	{
 		DownloadUrl downloadUrl(url);
 		downloadUrl.SetBearerToken(m_token);
@@ -33,6 +33,6 @@ namespace custard
 		}
 
 	private:
-		std::filesystem::path DownloadIcon(const std::wstring & url);
+		std::filesystem::path DownloadIcon(std::wstring_view url);
 	};
 }
@@ -0,0 +1,246 @@
+#include "httpcache.h"
+#include "jsontape.h"
+#include "jsonwriter.h"
+#include "utf.h"
+
+#include <atomic>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <system_error>
+
+namespace custard
+{
+	static std::wstring Hex(uint64_t value)
+	{
+		std::wstring text(16, L'0');
+
+		for (auto i = text.size(); i-- > 0; value >>= 4)
+		{
+			text[i] = L"0123456789abcdef"[value & 0xF];
+		}
+
+		return text;
+	}
+
+	static wchar_t AsciiLower(wchar_t ch) noexcept
+	{
+		return (ch >= L'A' && ch <= L'Z') ? (wchar_t) (ch + (L'a' - L'A')) : ch;
+	}
+
+	static int64_t Seconds(std::chrono::system_clock::time_point time) noexcept
+	{
+		return std::chrono::duration_cast<std::chrono::seconds>(time.time_since_epoch()).count();
+	}
+
+	// Calls directive with each comma-separated directive of a Cache-Control value, trimmed and in lower case.
+	template <typename Directive>
+	static void ForEachDirective(std::wstring_view cacheControl, Directive && directive)
+	{
+		while (!cacheControl.empty())
+		{
+			auto item = cacheControl.substr(0, cacheControl.find(L','));
+			cacheControl.remove_prefix(std::min(item.size() + 1, cacheControl.size()));
+
+			std::wstring lower;
+
+			for (auto ch : item)
+			{
+				if (ch != L' ' && ch != L'\t')
+				{
+					lower += AsciiLower(ch);
+				}
+			}
+
+			directive(std::wstring_view(lower));
+		}
+	}
+
+
+	bool HttpCacheEntry::Fresh(std::chrono::system_clock::time_point now) const noexcept
+	{
+		return Seconds(now) < expires;
+	}
+
+	std::wstring HttpCacheEntry::ConditionalHeaders() const
+	{
+		std::wstring headers;
+
+		if (!etag.empty())
+		{
+			headers += L"If-None-Match: " + etag + L"\r\n";
+		}
+
+		if (!lastModified.empty())
+		{
+			headers += L"If-Modified-Since: " + lastModified + L"\r\n";
+		}
+
+		return headers;
+	}
+
+
+	HttpCache::HttpCache(std::filesystem::path directory) : m_directory(std::move(directory))
+	{
+		std::filesystem::create_directories(m_directory);
+	}
+
+	HttpCache & HttpCache::Default()
+	{
+		static HttpCache cache(std::filesystem::temp_directory_path() / L"custard" / L"http-cache");
+		return cache;
+	}
+
+	// FNV-1a of the URL. An entry records its URL too, so a collision only costs a miss.
+	std::filesystem::path HttpCache::EntryPath(std::wstring_view url) const
+	{
+		uint64_t hash = 0xCBF29CE484222325;
+
+		for (auto ch : ConvertFrom(url))
+		{
+			hash = (hash ^ (uint8_t) ch) * 0x100000001B3;
+		}
+
+		return m_directory / (Hex(hash) + L".json");
+	}
+
+	std::optional<HttpCacheEntry> HttpCache::Find(std::wstring_view url) const
+	{
+		std::ifstream file(EntryPath(url), std::ios::binary);
+
+		if (!file)
+		{
+			return std::nullopt;
+		}
+
+		std::string text{ std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>() };
+
+		// A damaged or foreign entry is a miss like any other.
+		try
+		{
+			JsonTape tape(std::u8string_view((const char8_t *) text.data(), text.size()));
+			auto root = tape.Root();
+
+			HttpCacheEntry entry;
+			entry.url = root[L"url"].GetString().Str();
+
+			if (entry.url != url)
+			{
+				return std::nullopt;
+			}
+
+			entry.etag = root[L"etag"].GetString().Str();
+			entry.lastModified = root[L"lastModified"].GetString().Str();
+			entry.path = root[L"path"].GetString().Str();
+			entry.expires = root[L"expires"].GetNumber().Int64();
+
+			if (std::error_code ec; !std::filesystem::is_regular_file(entry.path, ec))
+			{
+				return std::nullopt;
+			}
+
+			return entry;
+		}
+		catch (const std::exception &)
+		{
+			return std::nullopt;
+		}
+	}
+
+	void HttpCache::Store(const HttpCacheEntry & entry)
+	{
+		JsonWriter writer;
+		writer.BeginObject()
+			.Key(L"url").String(entry.url)
+			.Key(L"etag").String(entry.etag)
+			.Key(L"lastModified").String(entry.lastModified)
+			.Key(L"path").String(entry.path.wstring())
+			.Key(L"expires").Number(entry.expires)
+			.EndObject();
+
+		WriteWholeFile(EntryPath(entry.url), writer.Bytes());
+	}
+
+	void HttpCache::Remove(std::wstring_view url) noexcept
+	{
+		std::error_code ec;
+		std::filesystem::remove(EntryPath(url), ec);
+	}
+
+	int64_t HttpCache::Expires(std::wstring_view cacheControl, std::chrono::system_clock::time_point now)
+	{
+		int64_t maxAge = 0;
+		bool noCache = false;
+
+		ForEachDirective(cacheControl, [&](std::wstring_view directive)
+		{
+			if (directive == L"no-cache")
+			{
+				noCache = true;
+			}
+			else if (directive.starts_with(L"max-age="))
+			{
+				maxAge = 0;
+
+				for (auto ch : directive.substr(8))
+				{
+					if (ch < L'0' || ch > L'9' || maxAge > INT32_MAX)
+					{
+						break;
+					}
+
+					maxAge = maxAge * 10 + (ch - L'0');
+				}
+			}
+		});
+
+		return Seconds(now) + (noCache ? 0 : maxAge);
+	}
+
+	bool HttpCache::NoStore(std::wstring_view cacheControl)
+	{
+		bool noStore = false;
+		ForEachDirective(cacheControl, [&noStore](std::wstring_view directive) { noStore = noStore || directive == L"no-store"; });
+		return noStore;
+	}
+
+	void WriteWholeFile(const std::filesystem::path & path, std::span<const std::byte> data)
+	{
+		auto temporary = HttpCache::TemporaryPath(path);
+		std::error_code ec;
+		{
+			std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+			file.write((const char *) data.data(), data.size());
+
+			if (!file.flush())
+			{
+				ec = std::make_error_code(std::errc::io_error);
+			}
+		}
+
+		if (!ec)
+		{
+			std::filesystem::rename(temporary, path, ec);
+		}
+
+		if (ec)
+		{
+			std::error_code ignored;
+			std::filesystem::remove(temporary, ignored);
+			throw std::system_error(ec, "std::filesystem::rename");
+		}
+	}
+
+	std::filesystem::path HttpCache::TemporaryPath(const std::filesystem::path & path)
+	{
+		static std::atomic<uint64_t> counter = []()
+		{
+			std::random_device random;
+			return ((uint64_t) random() << 32) | random();
+		}();
+
+		auto temporary = path;
+		temporary += L"." + Hex(counter++) + L".tmp";
+		return temporary;
+	}
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+
+namespace custard
+{
+	struct HttpCacheEntry
+	{
+		std::wstring url;
+		std::wstring etag;
+		std::wstring lastModified;
+		std::filesystem::path path;
+		int64_t expires = 0; // seconds since the epoch until which the copy is used without asking
+
+		bool Fresh(std::chrono::system_clock::time_point now = std::chrono::system_clock::now()) const noexcept;
+
+		// If-None-Match and If-Modified-Since lines for revalidating the copy, as Https sends headers.
+		std::wstring ConditionalHeaders() const;
+	};
+
+	//
+	// Files downloaded before, with what is needed to revalidate them.
+	//
+	// Each URL has an entry file of its own, named by a hash of the URL, so a lookup reads one small
+	// file whatever the size of the cache. Entries and downloads are written to temporary files and
+	// renamed into place, so concurrent processes see either the old or the new one, never half of one;
+	// the last writer wins.
+	//
+	class HttpCache
+	{
+		std::filesystem::path m_directory;
+
+	public:
+		explicit HttpCache(std::filesystem::path directory);
+		~HttpCache() noexcept = default;
+
+		// A cache under the system's temporary directory, shared by every process of the user.
+		static HttpCache & Default();
+
+		// The entry for url, if there is one and its file still exists.
+		std::optional<HttpCacheEntry> Find(std::wstring_view url) const;
+
+		// Throws if the entry cannot be replaced, as when another process has it open on Windows.
+		void Store(const HttpCacheEntry & entry);
+		void Remove(std::wstring_view url) noexcept;
+
+		// The expiry a response's Cache-Control allows; now for no-cache or no max-age, meaning ask again.
+		static int64_t Expires(std::wstring_view cacheControl, std::chrono::system_clock::time_point now = std::chrono::system_clock::now());
+
+		// Whether Cache-Control forbids keeping the response at all.
+		static bool NoStore(std::wstring_view cacheControl);
+
+		// A fresh name next to path, to write into before renaming the file to path.
+		static std::filesystem::path TemporaryPath(const std::filesystem::path & path);
+
+	private:
+		std::filesystem::path EntryPath(std::wstring_view url) const;
+	};
+
+	// Writes data to a temporary file and renames it to path, so that readers see all of it or none.
+	void WriteWholeFile(const std::filesystem::path & path, std::span<const std::byte> data);
+}
@@ -1,18 +1,43 @@
 #include "https.h"
 #include <stdexcept>
 #include <system_error>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
 
 using namespace custard;
 
-Session::Session() : Handle(::WinHttpOpen(L"A WinHTTP Program Custard/1.0", WINHTTP_ACCESS_TYPE_DEFAULT_PROXY, WINHTTP_NO_PROXY_NAME, WINHTTP_NO_PROXY_BYPASS, 0))
+//
+// With decompression on, WinHTTP sends Accept-Encoding: gzip, deflate and inflates the content inside
+// WinHttpReadData a chunk at a time, so every reader of a response sees decoded bytes. Windows before
+// 8.1 lacks the option; servers are then not offered compression at all.
+//
+Session::Session(DWORD flags) : Handle(::WinHttpOpen(L"A WinHTTP Program Custard/1.0", WINHTTP_ACCESS_TYPE_DEFAULT_PROXY, WINHTTP_NO_PROXY_NAME, WINHTTP_NO_PROXY_BYPASS, flags))
 {
 	if (!m_handle)
 	{
 		throw std::system_error(::GetLastError(), std::system_category(), "WinHttpOpen");
 	}
+
+	DWORD decompression = WINHTTP_DECOMPRESSION_FLAG_ALL;
+
+	if (!::WinHttpSetOption(m_handle, WINHTTP_OPTION_DECOMPRESSION, &decompression, sizeof(decompression)))
+	{
+		if (auto error = ::GetLastError(); error != ERROR_WINHTTP_INVALID_OPTION)
+		{
+			throw std::system_error(error, std::system_category(), "WinHttpSetOption");
+		}
+	}
 }
 
-Connection::Connection(Session & session, const wchar_t * host) : Handle(::WinHttpConnect(session, host, INTERNET_DEFAULT_HTTPS_PORT, 0))
+Connection::Connection(Session & session, const wchar_t * host, INTERNET_PORT port) : Handle(::WinHttpConnect(session, host, port, 0))
 {
 	if (m_handle == nullptr)
 	{
@@ -20,6 +45,46 @@ Connection::Connection(Session & session, const wchar_t * host) : Handle(::WinHt
 	}
 }
 
+ConnectionPool::ConnectionPool()
+{
+	DWORD max = MaxPerHost;
+
+	if (!::WinHttpSetOption(m_session, WINHTTP_OPTION_MAX_CONNS_PER_SERVER, &max, sizeof(max)))
+	{
+		throw std::system_error(::GetLastError(), std::system_category(), "WinHttpSetOption");
+	}
+
+	if (!::WinHttpSetOption(m_session, WINHTTP_OPTION_MAX_CONNS_PER_1_0_SERVER, &max, sizeof(max)))
+	{
+		throw std::system_error(::GetLastError(), std::system_category(), "WinHttpSetOption");
+	}
+}
+
+ConnectionPool & ConnectionPool::Instance()
+{
+	static ConnectionPool pool;
+	return pool;
+}
+
+std::shared_ptr<Connection> ConnectionPool::Acquire(std::wstring_view host, INTERNET_PORT port)
+{
+	auto now = std::chrono::steady_clock::now();
+
+	std::lock_guard lock(m_mutex);
+
+	std::erase_if(m_entries, [now](auto & entry) { return now - entry.second.lastUsed > IdleTimeout; });
+
+	auto & [key, entry] = *m_entries.try_emplace({ std::wstring(host), port }).first;
+
+	if (!entry.connection)
+	{
+		entry.connection = std::make_shared<Connection>(m_session, key.first.c_str(), port);
+	}
+
+	entry.lastUsed = now;
+	return entry.connection;
+}
+
 Request::Request(Connection & connection, const wchar_t * verb, const wchar_t * path) : Handle(::WinHttpOpenRequest(connection, verb, path, nullptr, WINHTTP_NO_REFERER, WINHTTP_DEFAULT_ACCEPT_TYPES, WINHTTP_FLAG_SECURE))
 {
 	if (m_handle == nullptr)
@@ -36,6 +101,19 @@ void Request::Send(const wchar_t * headers, void * content, uint32_t size)
 	}
 }
 
+void Request::NoDecompression()
+{
+	DWORD decompression = 0;
+
+	if (!::WinHttpSetOption(m_handle, WINHTTP_OPTION_DECOMPRESSION, &decompression, sizeof(decompression)))
+	{
+		if (auto error = ::GetLastError(); error != ERROR_WINHTTP_INVALID_OPTION)
+		{
+			throw std::system_error(error, std::system_category(), "WinHttpSetOption");
+		}
+	}
+}
+
 Response::Response(Request & request) : Handle(std::exchange(request.m_handle, nullptr))
 {
 	if (!::WinHttpReceiveResponse(m_handle, nullptr))
@@ -44,11 +122,11 @@ Response::Response(Request & request) : Handle(std::exchange(request.m_handle, n
 	}
 }
 
-std::wstring Response::Headers()
+static std::wstring QueryRawHeaders(HINTERNET hRequest)
 {
 	DWORD size = 0;
 
-	if (!::WinHttpQueryHeaders(m_handle, WINHTTP_QUERY_RAW_HEADERS_CRLF, nullptr, nullptr, &size, nullptr))
+	if (!::WinHttpQueryHeaders(hRequest, WINHTTP_QUERY_RAW_HEADERS_CRLF, nullptr, nullptr, &size, nullptr))
 	{
 		if (auto error = GetLastError(); error != ERROR_INSUFFICIENT_BUFFER)
 		{
@@ -58,7 +136,7 @@ std::wstring Response::Headers()
 
 	std::wstring buffer(size / sizeof(wchar_t) - 1, L'\0');
 
-	if (!::WinHttpQueryHeaders(m_handle, WINHTTP_QUERY_RAW_HEADERS_CRLF, nullptr, buffer.data(), &size, nullptr))
+	if (!::WinHttpQueryHeaders(hRequest, WINHTTP_QUERY_RAW_HEADERS_CRLF, nullptr, buffer.data(), &size, nullptr))
 	{
 		throw std::system_error(::GetLastError(), std::system_category(), "WinHttpQueryHeaders");
 	}
@@ -66,6 +144,11 @@ std::wstring Response::Headers()
 	return buffer;
 }
 
+std::wstring Response::Headers()
+{
+	return QueryRawHeaders(m_handle);
+}
+
 uint32_t Response::ContentLength()
 {
 	DWORD size = sizeof(DWORD);
@@ -82,11 +165,24 @@ uint32_t Response::ContentLength()
 	return length;
 }
 
-std::wstring Response::ContentType()
+uint32_t Response::StatusCode()
+{
+	DWORD size = sizeof(DWORD);
+	DWORD code = 0;
+
+	if (!::WinHttpQueryHeaders(m_handle, WINHTTP_QUERY_STATUS_CODE | WINHTTP_QUERY_FLAG_NUMBER, nullptr, &code, &size, nullptr))
+	{
+		throw std::system_error(::GetLastError(), std::system_category(), "WinHttpQueryHeaders");
+	}
+
+	return code;
+}
+
+std::wstring Response::Query(DWORD info)
 {
 	DWORD size = 0;
 
-	if (!::WinHttpQueryHeaders(m_handle, WINHTTP_QUERY_CONTENT_TYPE, nullptr, nullptr, &size, nullptr))
+	if (!::WinHttpQueryHeaders(m_handle, info, nullptr, nullptr, &size, nullptr))
 	{
 		auto error = GetLastError();
 
@@ -103,7 +199,7 @@ std::wstring Response::ContentType()
 
 	std::wstring buff(size / sizeof(wchar_t) - 1, L'\0');
 
-	if (!::WinHttpQueryHeaders(m_handle, WINHTTP_QUERY_CONTENT_TYPE, nullptr, buff.data(), &size, nullptr))
+	if (!::WinHttpQueryHeaders(m_handle, info, nullptr, buff.data(), &size, nullptr))
 	{
 		throw std::system_error(::GetLastError(), std::system_category(), "WinHttpQueryHeaders");
 	}
@@ -111,107 +207,271 @@ std::wstring Response::ContentType()
 	return buff;
 }
 
+std::wstring Response::ContentType()
+{
+	return Query(WINHTTP_QUERY_CONTENT_TYPE);
+}
+
 std::wstring Response::ContentEncoding()
 {
-	DWORD size = 0;
+	return Query(WINHTTP_QUERY_CONTENT_ENCODING);
+}
+
+//
+// WinHttpReadData waits for data on its own and reads nothing at the end of the body, so the reads need
+// no WinHttpQueryDataAvailable round trip before each of them.
+//
+
+static DWORD ReadData(HINTERNET hRequest, void * buffer, DWORD size)
+{
+	DWORD read = 0;
 
-	if (!::WinHttpQueryHeaders(m_handle, WINHTTP_QUERY_CONTENT_TRANSFER_ENCODING, nullptr, nullptr, &size, nullptr))
+	if (!::WinHttpReadData(hRequest, buffer, size, &read))
 	{
-		auto error = GetLastError();
+		throw std::system_error(::GetLastError(), std::system_category(), "WinHttpReadData");
+	}
 
-		if (error == ERROR_WINHTTP_HEADER_NOT_FOUND)
+	return read;
+}
+
+SegmentedBuffer Response::GetBody()
+{
+	SegmentedBuffer body;
+
+	for (;;)
+	{
+		auto space = body.Prepare();
+		auto read = ReadData(m_handle, space.data(), (DWORD) space.size());
+
+		if (read == 0)
 		{
-			return {};
+			return body;
 		}
 
-		if (error != ERROR_INSUFFICIENT_BUFFER)
+		if (body.size() + read > Maximum)
 		{
-			throw std::system_error(error, std::system_category(), "WinHttpQueryHeaders");
+			throw std::logic_error("Content is too large.");
 		}
+
+		body.Commit(read);
 	}
+}
 
-	std::wstring buff(size / sizeof(wchar_t) - 1, L'\0');
+std::vector<std::byte> Response::GetContent()
+{
+	auto length = ContentLength();
 
-	if (!::WinHttpQueryHeaders(m_handle, WINHTTP_QUERY_CONTENT_TRANSFER_ENCODING, nullptr, buff.data(), &size, nullptr))
+	if (length > Maximum)
 	{
-		throw std::system_error(::GetLastError(), std::system_category(), "WinHttpQueryHeaders");
+		throw std::logic_error("Content-Length is too large.");
 	}
 
-	return buff;
-}
+	// The Content-Length of encoded content counts the bytes before WinHTTP decoded them.
+	if (length == 0 || !ContentEncoding().empty())
+	{
+		return GetBody().ToVector();
+	}
 
-static DWORD QueryDataAvailable(HINTERNET hRequest)
-{
-	DWORD size = 0;
+	std::vector<std::byte> buff(length);
+	size_t offset = 0;
 
-	if (!::WinHttpQueryDataAvailable(hRequest, &size))
+	for (DWORD read = 0; offset < buff.size() && (read = ReadData(m_handle, buff.data() + offset, (DWORD) (buff.size() - offset))) > 0;)
 	{
-		throw std::system_error(::GetLastError(), std::system_category(), "WinHttpQueryDataAvailable");
+		offset += read;
 	}
 
-	return size;
+	buff.resize(offset);
+	return buff;
 }
 
-std::vector<std::byte> Response::GetContent()
+void Response::Recv(std::function<void(std::byte *, uint32_t)> callback)
 {
-	std::vector<std::byte> buff;
+	auto chunk = ChunkPool::Instance().Acquire();
 
-	if (auto length = ContentLength(); length == 0)
+	for (DWORD read = 0; (read = ReadData(m_handle, chunk.get(), ChunkPool::ChunkSize)) > 0;)
 	{
-		buff.reserve(Minimum);
+		callback(chunk.get(), read);
 	}
-	else if (length <= Maximum)
+}
+
+//
+// WinHttpTransport
+//
+// An exchange belongs to the status callback from the moment its request handle carries it as context,
+// and is deleted when that handle closes. The callbacks for one request never run concurrently.
+//
+
+struct AsyncExchange
+{
+	HttpRequest request;
+	Transport::Completion done;
+	HINTERNET connection = nullptr;
+	HINTERNET handle = nullptr;
+	HttpResponse response;
+	size_t received = 0;
+	bool completed = false;
+
+	void Complete(std::exception_ptr error)
 	{
-		buff.reserve(length);
+		if (!std::exchange(completed, true))
+		{
+			done(error, error ? HttpResponse{} : std::move(response));
+			::WinHttpCloseHandle(handle);
+		}
 	}
-	else
+};
+
+static void CALLBACK OnStatus(HINTERNET handle, DWORD_PTR context, DWORD status, LPVOID info, DWORD length)
+{
+	auto exchange = reinterpret_cast<AsyncExchange *>(context);
+
+	if (exchange == nullptr)
 	{
-		throw std::logic_error("Content-Length is too large.");
+		return;
 	}
 
-	size_t offset = 0;
-
-	for (auto size = QueryDataAvailable(m_handle), read = 0ul; size > 0; size = QueryDataAvailable(m_handle), offset += read)
+	try
 	{
-		buff.resize(offset + size);
+		switch (status)
+		{
+		case WINHTTP_CALLBACK_STATUS_SENDREQUEST_COMPLETE:
+			if (!::WinHttpReceiveResponse(handle, nullptr))
+			{
+				throw std::system_error(::GetLastError(), std::system_category(), "WinHttpReceiveResponse");
+			}
+			break;
 
-		if (!::WinHttpReadData(m_handle, buff.data() + offset, size, &read))
+		case WINHTTP_CALLBACK_STATUS_HEADERS_AVAILABLE:
 		{
-			throw std::system_error(::GetLastError(), std::system_category(), "WinHttpReadData");
+			DWORD code = 0;
+			DWORD size = sizeof(code);
+
+			if (!::WinHttpQueryHeaders(handle, WINHTTP_QUERY_STATUS_CODE | WINHTTP_QUERY_FLAG_NUMBER, nullptr, &code, &size, nullptr))
+			{
+				throw std::system_error(::GetLastError(), std::system_category(), "WinHttpQueryHeaders");
+			}
+
+			exchange->response.status = code;
+			exchange->response.headers = QueryRawHeaders(handle);
+
+			if (!::WinHttpQueryDataAvailable(handle, nullptr))
+			{
+				throw std::system_error(::GetLastError(), std::system_category(), "WinHttpQueryDataAvailable");
+			}
+			break;
 		}
 
-		if (read < size)
-		{
-			throw std::underflow_error(__FUNCTION__);
+		case WINHTTP_CALLBACK_STATUS_DATA_AVAILABLE:
+			if (auto size = *(DWORD *) info; size == 0)
+			{
+				exchange->Complete(nullptr);
+			}
+			else
+			{
+				auto & content = exchange->response.content;
+				content.resize(exchange->received + size);
+
+				if (!::WinHttpReadData(handle, content.data() + exchange->received, size, nullptr))
+				{
+					throw std::system_error(::GetLastError(), std::system_category(), "WinHttpReadData");
+				}
+			}
+			break;
+
+		case WINHTTP_CALLBACK_STATUS_READ_COMPLETE:
+			exchange->received += length;
+			exchange->response.content.resize(exchange->received);
+
+			if (length == 0)
+			{
+				exchange->Complete(nullptr);
+			}
+			else if (!::WinHttpQueryDataAvailable(handle, nullptr))
+			{
+				throw std::system_error(::GetLastError(), std::system_category(), "WinHttpQueryDataAvailable");
+			}
+			break;
+
+		case WINHTTP_CALLBACK_STATUS_REQUEST_ERROR:
+			throw std::system_error(((WINHTTP_ASYNC_RESULT *) info)->dwError, std::system_category(), "WinHttpSendRequest");
+
+		case WINHTTP_CALLBACK_STATUS_HANDLE_CLOSING:
+			::WinHttpCloseHandle(exchange->connection);
+			delete exchange;
+			break;
 		}
 	}
+	catch (...)
+	{
+		exchange->Complete(std::current_exception());
+	}
+}
 
-	return buff;
+WinHttpTransport::WinHttpTransport() : m_session(WINHTTP_FLAG_ASYNC)
+{
+	DWORD max = ConnectionPool::MaxPerHost;
+
+	if (!::WinHttpSetOption(m_session, WINHTTP_OPTION_MAX_CONNS_PER_SERVER, &max, sizeof(max)))
+	{
+		throw std::system_error(::GetLastError(), std::system_category(), "WinHttpSetOption");
+	}
+
+	if (::WinHttpSetStatusCallback(m_session, OnStatus, WINHTTP_CALLBACK_FLAG_ALL_COMPLETIONS | WINHTTP_CALLBACK_FLAG_HANDLES, 0) == WINHTTP_INVALID_STATUS_CALLBACK)
+	{
+		throw std::system_error(::GetLastError(), std::system_category(), "WinHttpSetStatusCallback");
+	}
 }
 
-void Response::Recv(std::function<void(std::byte *, uint32_t)> callback)
+void WinHttpTransport::Start(HttpRequest && request, Completion done)
 {
-	std::vector<std::byte> buff(Minimum);
+	auto exchange = std::make_unique<AsyncExchange>(std::move(request), std::move(done));
+	auto & req = exchange->request;
 
-	for (auto size = QueryDataAvailable(m_handle); size > 0; size = QueryDataAvailable(m_handle))
+	try
 	{
-		DWORD read{};
+		if (exchange->connection = ::WinHttpConnect(m_session, req.host.c_str(), req.port, 0); !exchange->connection)
+		{
+			throw std::system_error(::GetLastError(), std::system_category(), "WinHttpConnect");
+		}
+
+		if (exchange->handle = ::WinHttpOpenRequest(exchange->connection, req.verb.c_str(), req.path.c_str(), nullptr, WINHTTP_NO_REFERER, WINHTTP_DEFAULT_ACCEPT_TYPES, req.secure ? WINHTTP_FLAG_SECURE : 0); !exchange->handle)
+		{
+			throw std::system_error(::GetLastError(), std::system_category(), "WinHttpOpenRequest");
+		}
+
+		auto context = (DWORD_PTR) exchange.get();
 
-		if (!::WinHttpReadData(m_handle, buff.data(), Minimum, &read))
+		if (!::WinHttpSetOption(exchange->handle, WINHTTP_OPTION_CONTEXT_VALUE, &context, sizeof(context)))
+		{
+			throw std::system_error(::GetLastError(), std::system_category(), "WinHttpSetOption");
+		}
+	}
+	catch (...)
+	{
+		if (exchange->handle)
 		{
-			throw std::system_error(::GetLastError(), std::system_category(), "WinHttpReadData");
+			::WinHttpCloseHandle(exchange->handle);
 		}
 
-		if (read < size)
+		if (exchange->connection)
 		{
-			throw std::underflow_error(__FUNCTION__);
+			::WinHttpCloseHandle(exchange->connection);
 		}
 
-		callback(buff.data(), read);
+		exchange->done(std::current_exception(), {});
+		return;
+	}
+
+	auto owned = exchange.release();
+	auto size = (DWORD) req.content.size();
+
+	if (!::WinHttpSendRequest(owned->handle, req.headers.c_str(), -1L, req.content.data(), size, size, (DWORD_PTR) owned))
+	{
+		owned->Complete(std::make_exception_ptr(std::system_error(::GetLastError(), std::system_category(), "WinHttpSendRequest")));
 	}
 }
 
-Url::Url(std::wstring_view url) :
+Url::Url(std::wstring_view url, bool anyPort) :
 	URL_COMPONENTS{ .dwStructSize = sizeof(URL_COMPONENTS), .dwHostNameLength = DWORD(-1), .dwUrlPathLength = DWORD(-1) }, m_url(url)
 {
 	if (!::WinHttpCrackUrl(m_url.data(), (DWORD) m_url.size(), 0, this))
@@ -224,38 +484,224 @@ Url::Url(std::wstring_view url) :
 		throw std::runtime_error("Unsupported scheme.");
 	}
 
-	if (nPort != INTERNET_DEFAULT_HTTPS_PORT)
+	if (!anyPort && nPort != INTERNET_DEFAULT_HTTPS_PORT)
 	{
 		throw std::runtime_error("Unsupported port.");
 	}
 }
 
-struct FileWriter
+static uint64_t ParseLength(std::wstring_view text)
 {
-	HANDLE m_handle;
+	uint64_t length = 0;
 
-	FileWriter(const wchar_t * fileName) : m_handle(::CreateFileW(fileName, GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr))
+	if (text.empty())
 	{
-		if (m_handle == INVALID_HANDLE_VALUE)
+		return 0;
+	}
+
+	for (auto ch : text)
+	{
+		if (ch < L'0' || ch > L'9' || length > (UINT64_MAX - 9) / 10)
 		{
-			throw std::system_error(::GetLastError(), std::system_category(), "CreateFileW");
+			return 0;
 		}
+
+		length = length * 10 + (ch - L'0');
 	}
 
-	FileWriter(const FileWriter & other) : m_handle(INVALID_HANDLE_VALUE)
+	return length;
+}
+
+//
+// Writes a download to a file on a thread of its own, so that reading the next data does not wait for
+// the disk. Recv fills one buffer while the thread writes the others; Recv waits only when every
+// buffer is queued for writing. Call Finish() to write the rest and to see any error from the thread.
+//
+class FileWriter
+{
+	static constexpr size_t BufferCount = 3;
+	static constexpr size_t BufferSize = 4 * ChunkPool::ChunkSize;
+
+	struct Buffer
+	{
+		std::vector<std::byte> data = std::vector<std::byte>(BufferSize);
+		size_t size = 0;
+	};
+
+	std::array<Buffer, BufferCount> m_buffers;
+	HANDLE m_handle;
+	std::vector<Buffer *> m_free;
+	std::deque<Buffer *> m_full;
+	Buffer * m_current = nullptr;
+	bool m_closing = false;
+	std::exception_ptr m_error;
+	std::mutex m_mutex;
+	std::condition_variable m_changed;
+	std::thread m_thread;
+
+public:
+	FileWriter(const wchar_t * fileName, uint64_t length = 0) :
+		m_handle(::CreateFileW(fileName, GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr))
 	{
-		if (!::DuplicateHandle(::GetCurrentProcess(), other.m_handle, ::GetCurrentProcess(), &m_handle, 0, false, DUPLICATE_SAME_ACCESS))
+		if (m_handle == INVALID_HANDLE_VALUE)
+		{
+			throw std::system_error(::GetLastError(), std::system_category(), "CreateFileW");
+		}
+
+		// Only a hint, so that the file system can find the space in one piece; the file grows as written.
+		if (length > 0)
+		{
+			FILE_ALLOCATION_INFO info{};
+			info.AllocationSize.QuadPart = (LONGLONG) length;
+			::SetFileInformationByHandle(m_handle, FileAllocationInfo, &info, sizeof(info));
+		}
+
+		try
+		{
+			for (auto & buffer : m_buffers)
+			{
+				m_free.push_back(&buffer);
+			}
+
+			m_thread = std::thread(&FileWriter::WriteQueued, this);
+		}
+		catch (...)
 		{
-			throw std::system_error(::GetLastError(), std::system_category(), "DuplicateHandle");
+			::CloseHandle(m_handle);
+			throw;
 		}
 	}
 
 	~FileWriter() noexcept
 	{
+		{
+			std::lock_guard lock(m_mutex);
+			m_closing = true;
+		}
+
+		m_changed.notify_all();
+		m_thread.join();
 		::CloseHandle(m_handle);
 	}
 
-	void operator()(std::byte * data, uint32_t size)
+	FileWriter(const FileWriter &) = delete;
+	FileWriter & operator=(const FileWriter &) = delete;
+
+	void operator()(const SegmentedBuffer & body)
+	{
+		for (auto chunk : body)
+		{
+			(*this)(chunk.data(), (uint32_t) chunk.size());
+		}
+	}
+
+	void operator()(const std::byte * data, uint32_t size)
+	{
+		while (size > 0)
+		{
+			if (!m_current)
+			{
+				m_current = TakeFree();
+			}
+
+			auto count = std::min<size_t>(size, m_current->data.size() - m_current->size);
+
+			std::memcpy(m_current->data.data() + m_current->size, data, count);
+			m_current->size += count;
+			data += count;
+			size -= (uint32_t) count;
+
+			if (m_current->size == m_current->data.size())
+			{
+				Queue(std::exchange(m_current, nullptr));
+			}
+		}
+	}
+
+	void Finish()
+	{
+		if (m_current)
+		{
+			Queue(std::exchange(m_current, nullptr));
+		}
+
+		std::unique_lock lock(m_mutex);
+		m_changed.wait(lock, [this]() { return m_free.size() == BufferCount; });
+
+		if (m_error)
+		{
+			std::rethrow_exception(m_error);
+		}
+	}
+
+private:
+	Buffer * TakeFree()
+	{
+		std::unique_lock lock(m_mutex);
+		m_changed.wait(lock, [this]() { return !m_free.empty(); });
+
+		if (m_error)
+		{
+			std::rethrow_exception(m_error);
+		}
+
+		auto buffer = m_free.back();
+		m_free.pop_back();
+		return buffer;
+	}
+
+	void Queue(Buffer * buffer)
+	{
+		{
+			std::lock_guard lock(m_mutex);
+			m_full.push_back(buffer);
+		}
+
+		m_changed.notify_all();
+	}
+
+	// After an error the rest is dropped, and Recv learns of it when it next needs a buffer.
+	void WriteQueued() noexcept
+	{
+		std::unique_lock lock(m_mutex);
+
+		for (;;)
+		{
+			m_changed.wait(lock, [this]() { return !m_full.empty() || m_closing; });
+
+			if (m_full.empty())
+			{
+				return;
+			}
+
+			auto buffer = m_full.front();
+			m_full.pop_front();
+
+			if (!m_error)
+			{
+				std::exception_ptr error;
+				lock.unlock();
+
+				try
+				{
+					Write(buffer->data.data(), (DWORD) buffer->size);
+				}
+				catch (...)
+				{
+					error = std::current_exception();
+				}
+
+				lock.lock();
+				m_error = error;
+			}
+
+			buffer->size = 0;
+			m_free.push_back(buffer);
+			m_changed.notify_all();
+		}
+	}
+
+	void Write(const std::byte * data, DWORD size)
 	{
 		DWORD written = 0;
 
@@ -278,7 +724,63 @@ struct FileWriter
 	}
 };
 
-DownloadUrl::DownloadUrl(std::wstring_view url) : Url(url), Https(Host().c_str())
+//
+// Writes at given offsets, from any number of threads at once, into a file of a size set up front.
+//
+struct PositionalWriter
+{
+	HANDLE m_handle;
+
+	PositionalWriter(const wchar_t * fileName, uint64_t length) : m_handle(::CreateFileW(fileName, GENERIC_WRITE, 0, nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr))
+	{
+		if (m_handle == INVALID_HANDLE_VALUE)
+		{
+			throw std::system_error(::GetLastError(), std::system_category(), "CreateFileW");
+		}
+
+		LARGE_INTEGER size{};
+		size.QuadPart = (LONGLONG) length;
+
+		if (!::SetFilePointerEx(m_handle, size, nullptr, FILE_BEGIN) || !::SetEndOfFile(m_handle))
+		{
+			auto error = ::GetLastError();
+			::CloseHandle(m_handle);
+			throw std::system_error(error, std::system_category(), "SetEndOfFile");
+		}
+	}
+
+	~PositionalWriter() noexcept
+	{
+		::CloseHandle(m_handle);
+	}
+
+	PositionalWriter(const PositionalWriter &) = delete;
+	PositionalWriter & operator=(const PositionalWriter &) = delete;
+
+	// The OVERLAPPED only carries the offset; the handle is synchronous, so the write completes here.
+	void WriteAt(uint64_t offset, const std::byte * data, uint32_t size)
+	{
+		while (size > 0)
+		{
+			OVERLAPPED overlapped{};
+			overlapped.Offset = (DWORD) offset;
+			overlapped.OffsetHigh = (DWORD) (offset >> 32);
+
+			DWORD written = 0;
+
+			if (!::WriteFile(m_handle, data, size, &written, &overlapped))
+			{
+				throw std::system_error(::GetLastError(), std::system_category(), "WriteFile");
+			}
+
+			data += written;
+			size -= written;
+			offset += written;
+		}
+	}
+};
+
+DownloadUrl::DownloadUrl(std::wstring_view url) : Url(url), Https(Host().c_str(), Port())
 {
 	std::wstring_view path{ lpszUrlPath, dwUrlPathLength };
 
@@ -291,7 +793,24 @@ DownloadUrl::DownloadUrl(std::wstring_view url) : Url(url), Https(Host().c_str()
 	throw std::runtime_error("Invalid URL.");
 }
 
-std::filesystem::path DownloadUrl::SaveTo(const std::filesystem::path & dest)
+// The file is in place either way; an entry lost to another process only costs a request next time.
+static void StoreEntry(HttpCache & cache, const HttpCacheEntry & entry)
+{
+	try
+	{
+		cache.Store(entry);
+	}
+	catch (const std::system_error &)
+	{
+	}
+}
+
+//
+// A copy within its max-age is used without a request. An older one is revalidated with its ETag and
+// Last-Modified, and kept on 304 Not Modified. A new download goes to a temporary file first, so that
+// the file is always whole for other processes reading it.
+//
+std::filesystem::path DownloadUrl::SaveTo(const std::filesystem::path & dest, HttpCache & cache)
 {
 	std::error_code ec{};
 
@@ -301,64 +820,192 @@ std::filesystem::path DownloadUrl::SaveTo(const std::filesystem::path & dest)
 	}
 
 	auto file = dest / m_fileName;
+	auto entry = cache.Find(Str());
+	std::wstring conditional;
 
-	// TODO: ^CX^vgăLbV
+	if (entry && entry->path == file)
+	{
+		if (entry->Fresh())
+		{
+			return file;
+		}
 
-	Response response = Get(Path().c_str());
-	response.Recv(FileWriter(file.c_str()));
+		conditional = entry->ConditionalHeaders();
+	}
+	else
+	{
+		entry.reset();
+	}
+
+	Response response = Get(Path().c_str(), conditional);
+	auto status = response.StatusCode();
+	auto cacheControl = response.Query(WINHTTP_QUERY_CACHE_CONTROL);
 
 #if defined(_DEBUG)
 	::OutputDebugStringW(L"=== Response ===\r\n");
 	::OutputDebugStringW(response.Headers().c_str());
 	::OutputDebugStringW(L"================\r\n");
 #endif
+
+	if (status == HTTP_STATUS_NOT_MODIFIED && entry)
+	{
+		entry->expires = HttpCache::Expires(cacheControl);
+		StoreEntry(cache, *entry);
+		return file;
+	}
+
+	if (status != HTTP_STATUS_OK)
+	{
+		throw std::runtime_error("Unexpected status " + std::to_string(status) + ".");
+	}
+
+	auto temporary = HttpCache::TemporaryPath(file);
+
+	try
+	{
+		{
+			// Encoded content is decoded as it is read, to a length not known up front.
+			FileWriter writer(temporary.c_str(), response.ContentEncoding().empty() ? ParseLength(response.Query(WINHTTP_QUERY_CONTENT_LENGTH)) : 0);
+			response.Recv(std::ref(writer));
+			writer.Finish();
+		}
+
+		std::filesystem::rename(temporary, file);
+	}
+	catch (...)
+	{
+		std::filesystem::remove(temporary, ec);
+		throw;
+	}
+
+	if (HttpCache::NoStore(cacheControl))
+	{
+		cache.Remove(Str());
+	}
+	else
+	{
+		StoreEntry(cache, { Str(), response.Query(WINHTTP_QUERY_ETAG), response.Query(WINHTTP_QUERY_LAST_MODIFIED), file, HttpCache::Expires(cacheControl) });
+	}
+
 	return file;
 }
 
-namespace custard
+std::filesystem::path DownloadUrl::SaveInRanges(const std::filesystem::path & dest, size_t count, HttpCache & cache)
 {
-	std::u8string ConvertFrom(std::wstring_view wstr)
+	std::error_code ec{};
+
+	if (!std::filesystem::is_directory(dest, ec))
 	{
-		const auto wstr_size = (int) wstr.size();
-		const auto utf8_size = ::WideCharToMultiByte(CP_UTF8, 0, wstr.data(), wstr_size, nullptr, 0, nullptr, nullptr);
+		throw std::system_error(ec, "std::filesystem::is_directory");
+	}
 
-		if (utf8_size <= 0)
-		{
-			throw std::system_error(::GetLastError(), std::system_category(), "WideCharToMultiByte");
-		}
+	auto file = dest / m_fileName;
+
+	if (auto entry = cache.Find(Str()); entry && entry->path == file && entry->Fresh())
+	{
+		return file;
+	}
 
-		std::u8string utf8(utf8_size, '\0');
+	Response probe = Head(Path().c_str());
 
-		if (::WideCharToMultiByte(CP_UTF8, 0, wstr.data(), wstr_size, (char *) utf8.data(), utf8_size, nullptr, nullptr) == 0)
-		{
-			throw std::system_error(::GetLastError(), std::system_category(), "WideCharToMultiByte");
-		}
+	auto length = ParseLength(probe.Query(WINHTTP_QUERY_CONTENT_LENGTH));
+	auto etag = probe.Query(WINHTTP_QUERY_ETAG);
+	auto lastModified = probe.Query(WINHTTP_QUERY_LAST_MODIFIED);
+	auto validator = etag.empty() ? lastModified : etag;
 
-		return utf8;
+	// Ranges of encoded content would count encoded bytes, which WinHTTP cannot decode piecemeal. A weak
+	// ETag may not be sent in If-Range, and servers answer it with the whole file.
+	if (probe.StatusCode() != HTTP_STATUS_OK || probe.Query(WINHTTP_QUERY_ACCEPT_RANGES) != L"bytes" || !probe.ContentEncoding().empty() ||
+		length < 2 * RangedDownload::MinRangeSize || etag.starts_with(L"W/"))
+	{
+		return SaveTo(dest, cache);
 	}
 
-	std::wstring ConvertFrom(std::u8string_view utf8)
+	auto partial = file;
+	partial += L".part";
+	auto sidecar = partial;
+	sidecar += L".json";
+
+	// Without a validator a file that changed but kept its length cannot be told apart, so no earlier
+	// progress is trusted.
+	if (validator.empty() || !std::filesystem::exists(partial, ec))
 	{
-		const auto utf8_size = (int) utf8.size();
-		const auto wstr_size = ::MultiByteToWideChar(CP_UTF8, 0, (const char *) utf8.data(), utf8_size, nullptr, 0);
+		std::filesystem::remove(sidecar, ec);
+	}
 
-		if (wstr_size <= 0)
-		{
-			throw std::system_error(::GetLastError(), std::system_category(), "MultiByteToWideChar");
-		}
+	RangedDownload progress(sidecar, Str(), validator, length, std::min<size_t>(count, ConnectionPool::MaxPerHost));
 
-		std::wstring wstr(wstr_size, L'\0');
+	auto ranges = progress.Ranges();
+	std::exception_ptr error;
+	{
+		PositionalWriter output(partial.c_str(), length);
+
+		std::mutex mutex;
+		std::atomic<bool> failed = false;
+		std::vector<std::jthread> workers;
 
-		if (::MultiByteToWideChar(CP_UTF8, 0, (const char *) utf8.data(), utf8_size, wstr.data(), wstr_size) == 0)
+		for (size_t index = 0; index < ranges.size(); ++index)
 		{
-			throw std::system_error(::GetLastError(), std::system_category(), "MultiByteToWideChar");
-		}
+			if (ranges[index].Complete())
+			{
+				continue;
+			}
 
-		return wstr;
+			workers.emplace_back([&, index, range = ranges[index]]()
+			{
+				try
+				{
+					// If-Range makes a changed file come back whole with 200, which is then refused.
+					auto headers = validator.empty() ? std::wstring() : std::format(L"If-Range: {}\r\n", validator);
+
+					Response response = GetRange(Path().c_str(), range.Next(), range.end - 1, headers);
+
+					if (response.StatusCode() != HTTP_STATUS_PARTIAL_CONTENT || !response.ContentEncoding().empty())
+					{
+						throw std::runtime_error("The server did not return the range.");
+					}
+
+					auto offset = range.Next();
+
+					response.Recv([&](std::byte * data, uint32_t size)
+					{
+						if (failed || size > range.end - offset)
+						{
+							throw std::runtime_error("Range download stopped.");
+						}
+
+						output.WriteAt(offset, data, size);
+						offset += size;
+						progress.Advance(index, size);
+					});
+
+					if (offset != range.end)
+					{
+						throw std::runtime_error("The range ended early.");
+					}
+				}
+				catch (...)
+				{
+					std::lock_guard lock(mutex);
+
+					if (!failed.exchange(true))
+					{
+						error = std::current_exception();
+					}
+				}
+			});
+		}
 	}
 
-	std::wstring ConvertFrom(const std::vector<std::byte> & data)
+	if (error)
 	{
-		return ConvertFrom({ (const char8_t *) data.data(), data.size() });
+		progress.Save();
+		std::rethrow_exception(error);
 	}
+
+	std::filesystem::rename(partial, file);
+	progress.Remove();
+
+	StoreEntry(cache, { Str(), etag, lastModified, file, HttpCache::Expires(probe.Query(WINHTTP_QUERY_CACHE_CONTROL)) });
+	return file;
 }
@@ -3,15 +3,27 @@
 #include <Windows.h>
 #include <winhttp.h>
 
+#include "httpcache.h"
+#include "rangeddownload.h"
+#include "segmentedbuffer.h"
+#include "transport.h"
+#include "utf.h"
+
 #include <string>
 #include <string_view>
 
 #include <cstddef> 
+#include <span>
 #include <vector>
 
+#include <chrono>
 #include <format>
 #include <functional>
 #include <filesystem>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <utility>
 
 namespace custard
 {
@@ -44,22 +56,64 @@ namespace custard
 
 	struct Session : Handle
 	{
-		Session();
+		Session(DWORD flags = 0);
 		~Session() noexcept = default;
 	};
 
 	struct Connection : Handle
 	{
-		Connection(Session & session, const wchar_t * host);
+		Connection(Session & session, const wchar_t * host, INTERNET_PORT port = INTERNET_DEFAULT_HTTPS_PORT);
 		~Connection() noexcept = default;
 	};
 
+	//
+	// Connections shared by every Https in the process, keyed by host and port.
+	//
+	// WinHTTP keeps the sockets of finished requests alive per session, so handing out connections from
+	// one session lets a request reuse the socket and TLS session of an earlier one to the same server.
+	// At most MaxPerHost sockets are opened to a server; further requests wait for one of them.
+	//
+	// WinHTTP, not the pool, decides how long those sockets stay open while idle. IdleTimeout only
+	// bounds the pool's own bookkeeping: when a later Acquire runs, connection handles that no Https
+	// has asked for in that time are dropped from the map, and a handle closes once the last Https
+	// holding it goes away. Nothing expires between calls to Acquire.
+	//
+	class ConnectionPool
+	{
+		struct Entry
+		{
+			std::shared_ptr<Connection> connection;
+			std::chrono::steady_clock::time_point lastUsed;
+		};
+
+		Session m_session;
+		std::mutex m_mutex;
+		std::map<std::pair<std::wstring, INTERNET_PORT>, Entry> m_entries;
+
+	public:
+		static constexpr DWORD MaxPerHost = 6;
+		static constexpr std::chrono::seconds IdleTimeout{ 90 }; // for pool entries, not sockets
+
+		ConnectionPool();
+		~ConnectionPool() noexcept = default;
+
+		static ConnectionPool & Instance();
+
+		std::shared_ptr<Connection> Acquire(std::wstring_view host, INTERNET_PORT port = INTERNET_DEFAULT_HTTPS_PORT);
+
+		ConnectionPool(const ConnectionPool &) = delete;
+		ConnectionPool & operator=(const ConnectionPool &) = delete;
+	};
+
 	struct Request : Handle
 	{
 		Request(Connection & connection, const wchar_t * verb, const wchar_t * path);
 		~Request() noexcept = default;
 
 		void Send(const wchar_t * headers, void * content, uint32_t size);
+
+		// Turns off the session's decompression for this request, which then asks for the content as stored.
+		void NoDecompression();
 	};
 
 	struct Response : Handle
@@ -67,28 +121,36 @@ namespace custard
 		Response(Request & request);
 		~Response() noexcept = default;
 
+		uint32_t StatusCode();
+
 		std::wstring Headers();
 		std::wstring ContentType();
 		std::wstring ContentEncoding();
 
-		const uint32_t Minimum = (uint32_t) 16 * 1024;
+		// The value of a header such as WINHTTP_QUERY_ETAG, or an empty string when there is none.
+		std::wstring Query(DWORD info);
+
 		const uint32_t Maximum = (uint32_t) 16 * 1024 * 1024;
 
 		uint32_t ContentLength();
 
+		// The rest of the body, decoded and up to Maximum, read straight into pooled chunks.
+		SegmentedBuffer GetBody();
+
+		// As GetBody, but in one vector; sized once from Content-Length when the content is not encoded.
 		std::vector<std::byte> GetContent();
 
+		// Hands the body to callback a chunk at a time, as it is read.
 		void Recv(std::function<void(std::byte *, uint32_t)> callback);
 	};
 
 	class Https
 	{
-		Session m_session;
-		Connection m_connection;
+		std::shared_ptr<Connection> m_connection;
 		std::wstring m_headers;
 
 	public:
-		Https(const wchar_t * host) : m_connection(m_session, host)
+		Https(const wchar_t * host, INTERNET_PORT port = INTERNET_DEFAULT_HTTPS_PORT) : m_connection(ConnectionPool::Instance().Acquire(host, port))
 		{}
 
 		void SetBearerToken(std::wstring_view token)
@@ -103,17 +165,68 @@ namespace custard
 
 		Response Get(const wchar_t * path)
 		{
-			Request request(m_connection, L"GET", path);
+			Request request(*m_connection, L"GET", path);
 			request.Send(m_headers.c_str(), nullptr, 0);
 			return Response(request);
 		}
 
+		// For the content as stored, so that Content-Length is what GetRange counts.
+		Response Head(const wchar_t * path)
+		{
+			auto all = m_headers + L"Accept-Encoding: identity\r\n";
+			Request request(*m_connection, L"HEAD", path);
+			request.NoDecompression();
+			request.Send(all.c_str(), nullptr, 0);
+			return Response(request);
+		}
+
+		// With headers for this request only, after the common ones.
+		Response Get(const wchar_t * path, std::wstring_view headers)
+		{
+			auto all = m_headers + std::wstring(headers);
+			Request request(*m_connection, L"GET", path);
+			request.Send(all.c_str(), nullptr, 0);
+			return Response(request);
+		}
+
+		// Byte ranges count the content as stored, so these must not be encoded for the transfer.
+		Response GetRange(const wchar_t * path, uint64_t first, uint64_t last, std::wstring_view headers)
+		{
+			auto all = m_headers + std::format(L"Range: bytes={}-{}\r\nAccept-Encoding: identity\r\n", first, last) + std::wstring(headers);
+			Request request(*m_connection, L"GET", path);
+			request.NoDecompression();
+			request.Send(all.c_str(), nullptr, 0);
+			return Response(request);
+		}
+
 		Response Post(const wchar_t * path, void * content, uint32_t size)
 		{
-			Request request(m_connection, L"POST", path);
+			Request request(*m_connection, L"POST", path);
 			request.Send(m_headers.c_str(), content, size);
 			return Response(request);
 		}
+
+		// WinHTTP only reads the content, so it is sent straight from the caller's buffer.
+		Response Post(const wchar_t * path, std::span<const std::byte> content)
+		{
+			return Post(path, const_cast<std::byte *>(content.data()), (uint32_t) content.size());
+		}
+	};
+
+	//
+	// A Transport on WinHTTP's asynchronous mode. Each request is driven by status callbacks on
+	// WinHTTP's own thread pool, so no thread waits on it; the session keeps sockets and TLS sessions
+	// alive across requests, up to ConnectionPool::MaxPerHost per server. It must outlive its requests.
+	//
+	class WinHttpTransport : public Transport
+	{
+		Session m_session;
+
+	public:
+		WinHttpTransport();
+		~WinHttpTransport() noexcept override = default;
+
+		void Start(HttpRequest && request, Completion done) override;
 	};
 
 	class Url : protected URL_COMPONENTS
@@ -121,7 +234,9 @@ namespace custard
 		std::wstring m_url;
 
 	public:
-		Url(std::wstring_view url);
+		// Only https on its default port, as URLs come from API responses, unless anyPort is set for
+		// a server the caller chose, such as a local stand-in.
+		Url(std::wstring_view url, bool anyPort = false);
 		~Url() noexcept = default;
 
 		std::wstring Host() const
@@ -129,11 +244,21 @@ namespace custard
 			return { lpszHostName, dwHostNameLength };
 		}
 
+		INTERNET_PORT Port() const noexcept
+		{
+			return nPort;
+		}
+
 		std::wstring Path() const
 		{
 			return { lpszUrlPath, dwUrlPathLength };
 		}
 
+		const std::wstring & Str() const noexcept
+		{
+			return m_url;
+		}
+
 		Url(const Url &) = delete;
 		Url(Url &&) = delete;
 
@@ -149,10 +274,15 @@ namespace custard
 		DownloadUrl(std::wstring_view url);
 		~DownloadUrl() noexcept = default;
 
-		std::filesystem::path SaveTo(const std::filesystem::path & dest);
-	};
+		// Downloads into dest unless cache holds a copy there that is fresh or that the server confirms.
+		std::filesystem::path SaveTo(const std::filesystem::path & dest, HttpCache & cache = HttpCache::Default());
 
-	std::u8string ConvertFrom(std::wstring_view wstr);
-	std::wstring ConvertFrom(std::u8string_view u8str);
-	std::wstring ConvertFrom(const std::vector<std::byte> & data);
+		//
+		// As SaveTo, but fetches up to count byte ranges at once, each on its own request over the pooled
+		// connection, into a preallocated "<name>.part" file. Progress is kept in "<name>.part.json", and a
+		// later call resumes from it, if the file has a validator. Falls back to SaveTo when the server does
+		// not take byte ranges, the file is too small to split, or its ETag is weak.
+		//
+		std::filesystem::path SaveInRanges(const std::filesystem::path & dest, size_t count = 4, HttpCache & cache = HttpCache::Default());
+	};
 }
@@ -1,119 +1,473 @@
 #include "json.h"
+#include "jsonsax.h"
+#include "jsontokenizer.h"
+#include "simd.h"
+#include "utf.h"
 
-#include <stack>
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cstring>
+#include <limits>
 #include <stdexcept>
+#include <string>
 
 namespace custard
 {
-	static std::uint16_t FromHexChar(wchar_t ch)
+	// Values of hex digits, -1 for any other byte.
+	static constexpr auto HexValues = []()
 	{
-		static constexpr wchar_t hexChars[] = L"0123456789ABCDEF";
+		std::array<int8_t, 256> values{};
 
-		if (auto pos = wcschr(hexChars, towupper(ch)))
+		values.fill(-1);
+
+		for (int i = 0; i < 10; i++)
+		{
+			values['0' + i] = (int8_t) i;
+		}
+
+		for (int i = 0; i < 6; i++)
+		{
+			values['A' + i] = values['a' + i] = (int8_t) (10 + i);
+		}
+
+		return values;
+	}();
+
+	template <typename CharT>
+	static char32_t ReadHex4(const CharT *& ptr, const CharT * end)
+	{
+		if ((end - ptr) < 4)
+		{
+			throw std::invalid_argument("Invalid escape sequence.");
+		}
+
+		int32_t value = 0;
+		int32_t invalid = 0;
+
+		for (int i = 0; i < 4; i++)
+		{
+			auto ch = (std::make_unsigned_t<CharT>) *ptr++;
+			int32_t digit = (ch < HexValues.size()) ? HexValues[ch] : -1;
+
+			value = (value << 4) | (digit & 0xF);
+			invalid |= digit;
+		}
+
+		if (invalid < 0)
 		{
-			return (std::uint16_t) (pos - hexChars);
+			throw std::invalid_argument("Invalid hex character.");
 		}
 
-		throw new std::invalid_argument("Invalid hex character.");
+		return (char32_t) value;
 	}
 
-	static wchar_t ValidateEscapeChar(wchar_t ch)
+	// Decodes the escape sequence after a backslash. A \u escape of a high surrogate followed by one of
+	// a low surrogate is a single code point; a surrogate on its own becomes U+FFFD.
+	template <typename CharT>
+	static char32_t DecodeEscape(const CharT *& ptr, const CharT * end)
 	{
-		switch (ch)
+		char32_t ch = ValidateEscapeChar(*ptr++);
+
+		if (ch != L'\0')
+		{
+			return ch;
+		}
+
+		ch = ReadHex4(ptr, end);
+
+		if (ch < 0xD800 || ch >= 0xE000)
 		{
-		case L'"':
-		case L'\\':
-		case L'/':
 			return ch;
-		case L'b':
-			return L'\b';
-		case L'f':
-			return L'\f';
-		case L'n':
-			return L'\n';
-		case L'r':
-			return L'\r';
-		case L't':
-			return L'\t';
-		case L'u':
-			return L'\0';
-		default:
-			throw new std::invalid_argument("Invalid escape character.");
 		}
+
+		if (ch < 0xDC00 && (end - ptr) >= 6 && ptr[0] == '\\' && ptr[1] == 'u')
+		{
+			auto next = ptr + 2;
+			auto low = ReadHex4(next, end);
+
+			if (low >= 0xDC00 && low < 0xE000)
+			{
+				ptr = next;
+				return 0x10000 + ((ch - 0xD800) << 10) + (low - 0xDC00);
+			}
+		}
+
+		return 0xFFFD;
 	}
 
-	static std::wstring UnescapeString(const wchar_t * ptr, const wchar_t * end)
+	template <typename Sink>
+	static bool PutWide(char32_t ch, Sink && sink)
 	{
-		std::wstring buff;
+		if (sizeof(wchar_t) == 2 && ch >= 0x10000)
+		{
+			ch -= 0x10000;
+			return sink((wchar_t) (0xD800 | (ch >> 10))) && sink((wchar_t) (0xDC00 | (ch & 0x3FF)));
+		}
 
-		buff.reserve(end - ptr);
+		return sink((wchar_t) ch);
+	}
+
+	static wchar_t * CopyRun(const wchar_t * ptr, const wchar_t * end, wchar_t * out) noexcept
+	{
+		return std::copy(ptr, end, out);
+	}
+
+	static wchar_t * CopyRun(const char8_t * ptr, const char8_t * end, wchar_t * out) noexcept
+	{
+		return ConvertTo(std::u8string_view(ptr, end), out);
+	}
+
+	static char8_t * CopyRun(const char8_t * ptr, const char8_t * end, char8_t * out) noexcept
+	{
+		return std::copy(ptr, end, out);
+	}
+
+	static char8_t * CopyRun(const wchar_t * ptr, const wchar_t * end, char8_t * out) noexcept
+	{
+		return ConvertTo(std::wstring_view(ptr, end), out);
+	}
+
+	//
+	// Writes the decoded text of a string token to out and returns the end of the output. Neither an
+	// escape sequence nor a UTF-8 sequence decodes to more code units than it has, so out needs room
+	// for as many code units as the token has, or MaxUtf8Length of them to encode wide text.
+	//
+	// Runs between backslashes are located a block at a time and copied, or transcoded, in bulk.
+	//
+	template <typename CharT, typename OutT>
+	static OutT * DecodeString(const CharT * ptr, const CharT * end, bool escaped, OutT * out)
+	{
+		if (!escaped)
+		{
+			return CopyRun(ptr, end, out);
+		}
 
 		while (ptr < end)
 		{
-			auto ch = *ptr++;
+			// Quotes only appear escaped, except in unquoted tokens where they are ordinary text.
+			auto run = simd::FindQuoteOrEscape(ptr, end);
+
+			out = CopyRun(ptr, run, out);
+
+			if ((ptr = run) == end)
+			{
+				break;
+			}
+
+			if (*ptr++ == '"')
+			{
+				*out++ = '"';
+				continue;
+			}
 
-			if (ch == L'\\')
+			if constexpr (sizeof(OutT) == 1)
 			{
-				ch = ValidateEscapeChar(*ptr++);
+				out = EncodeUtf8(DecodeEscape(ptr, end), out);
+			}
+			else
+			{
+				out = EncodeWide(DecodeEscape(ptr, end), out);
+			}
+		}
+
+		return out;
+	}
+
 
-				if (ch == L'\0')
+	// Feeds the decoded code units of a string token to sink until it returns false.
+	template <typename CharT, typename Sink>
+	static bool ForEachUnit(const CharT * ptr, const CharT * end, Sink && sink)
+	{
+		while (ptr < end)
+		{
+			char32_t ch;
+
+			if (*ptr == '\\')
+			{
+				++ptr;
+				ch = DecodeEscape(ptr, end);
+			}
+			else if constexpr (sizeof(CharT) == 1)
+			{
+				ch = DecodeUtf8(ptr, end);
+			}
+			else
+			{
+				ch = (std::make_unsigned_t<CharT>) *ptr++;
+			}
+
+			if (!PutWide(ch, sink))
+			{
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+
+	// Eight ASCII digits packed little-endian into v, most significant first.
+	static bool IsEightDigits(uint64_t v) noexcept
+	{
+		return (((v & 0xF0F0F0F0F0F0F0F0) | (((v + 0x0606060606060606) & 0xF0F0F0F0F0F0F0F0) >> 4)) == 0x3333333333333333);
+	}
+
+	static uint32_t ParseEightDigits(uint64_t v) noexcept
+	{
+		v -= 0x3030303030303030;
+		v = (v * 10) + (v >> 8);
+		return (uint32_t) ((((v & 0x000000FF000000FF) * (100 + (1000000ULL << 32))) + (((v >> 16) & 0x000000FF000000FF) * (1 + (10000ULL << 32)))) >> 32);
+	}
+
+	template <typename CharT>
+	static uint64_t LoadEight(const CharT * ptr) noexcept
+	{
+		uint64_t v = 0;
+
+		if constexpr (sizeof(CharT) == 1)
+		{
+			std::memcpy(&v, ptr, 8);
+		}
+		else
+		{
+			// Wide units outside ASCII become 0xFF, which is not a digit.
+			for (int i = 0; i < 8; i++)
+			{
+				v |= (uint64_t) ((ptr[i] < 0x80) ? ptr[i] : 0xFF) << (i * 8);
+			}
+		}
+
+		return v;
+	}
+
+	template <typename CharT>
+	static bool IsDigit(CharT ch) noexcept
+	{
+		return ch >= '0' && ch <= '9';
+	}
+
+	//
+	// -?(0|[1-9][0-9]*)(.[0-9]+)?([eE][+-]?[0-9]+)? split into up to 19 significant digits and a
+	// decimal exponent.
+	//
+	struct NumberParts
+	{
+		uint64_t mantissa;
+		int64_t exponent;
+		int digits;
+		bool negative;
+		bool integer;
+		bool truncated;
+
+		template <typename CharT>
+		void Digits(const CharT *& ptr, const CharT * end, bool fraction)
+		{
+			auto begin = ptr;
+
+			for (uint64_t v; end - ptr >= 8 && digits <= 11 && IsEightDigits(v = LoadEight(ptr)); ptr += 8)
+			{
+				mantissa = mantissa * 100000000 + ParseEightDigits(v);
+				digits += mantissa ? 8 : 0;
+				exponent -= fraction ? 8 : 0;
+			}
+
+			for (; ptr < end && IsDigit(*ptr); ++ptr)
+			{
+				if (digits < 19)
 				{
-					if ((end - ptr) < 4)
-					{
-						throw new std::invalid_argument("Invalid escape sequence.");
-					}
+					mantissa = mantissa * 10 + (*ptr - '0');
+					digits += mantissa ? 1 : 0;
+					exponent -= fraction ? 1 : 0;
+				}
+				else
+				{
+					truncated = true;
+					exponent += fraction ? 0 : 1;
+				}
+			}
+
+			if (ptr == begin)
+			{
+				throw std::invalid_argument("Invalid number.");
+			}
+		}
+
+		template <typename CharT>
+		NumberParts(const CharT * ptr, const CharT * end) : mantissa(0), exponent(0), digits(0), negative(false), integer(true), truncated(false)
+		{
+			if (ptr < end && *ptr == '-')
+			{
+				negative = true;
+				++ptr;
+			}
+
+			if (ptr < end && *ptr == '0')
+			{
+				++ptr;
+			}
+			else
+			{
+				Digits(ptr, end, false);
+			}
+
+			if (ptr < end && *ptr == '.')
+			{
+				integer = false;
+				Digits(++ptr, end, true);
+			}
+
+			if (ptr < end && (*ptr == 'e' || *ptr == 'E'))
+			{
+				integer = false;
+
+				bool minus = (++ptr < end && *ptr == '-');
+
+				if (ptr < end && (*ptr == '-' || *ptr == '+'))
+				{
+					++ptr;
+				}
+
+				int64_t value = 0;
+				auto begin = ptr;
+
+				for (; ptr < end && IsDigit(*ptr); ++ptr)
+				{
+					value = (value < 100000) ? value * 10 + (*ptr - '0') : value;
+				}
 
-					ch |= FromHexChar(*ptr++);
-					ch <<= 4;
-					ch |= FromHexChar(*ptr++);
-					ch <<= 4;
-					ch |= FromHexChar(*ptr++);
-					ch <<= 4;
-					ch |= FromHexChar(*ptr++);
+				if (ptr == begin)
+				{
+					throw std::invalid_argument("Invalid number.");
 				}
+
+				exponent += minus ? -value : value;
+			}
+
+			if (ptr != end)
+			{
+				throw std::invalid_argument("Invalid number.");
 			}
+		}
+	};
 
-			buff.push_back(ch);
+	template <typename CharT>
+	static double FromChars(const CharT * ptr, const CharT * end)
+	{
+		double value = 0;
+		std::from_chars_result result;
+
+		if constexpr (sizeof(CharT) == 1)
+		{
+			result = std::from_chars((const char *) ptr, (const char *) end, value);
+			result.ptr = (result.ptr == (const char *) end) ? result.ptr : nullptr;
+		}
+		else
+		{
+			std::string text(ptr, end);
+			result = std::from_chars(text.data(), text.data() + text.size(), value);
+			result.ptr = (result.ptr == text.data() + text.size()) ? result.ptr : nullptr;
+		}
+
+		if (result.ec == std::errc::result_out_of_range)
+		{
+			throw std::out_of_range("Number out of range.");
 		}
 
-		return buff;
+		if (result.ec != std::errc() || result.ptr == nullptr)
+		{
+			throw std::invalid_argument("Invalid number.");
+		}
+
+		return value;
 	}
 
+	template <typename CharT>
+	static double ToDouble(const CharT * ptr, const CharT * end)
+	{
+		static constexpr double powers[] =
+		{
+			1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+			1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+		};
+
+		NumberParts parts(ptr, end);
+
+		// Both the mantissa and the power of ten are exact, so is one rounding (Clinger).
+		if (!parts.truncated && parts.mantissa <= (1ULL << 53) && parts.exponent >= -22 && parts.exponent <= 22)
+		{
+			double value = (double) parts.mantissa;
+			value = (parts.exponent < 0) ? value / powers[-parts.exponent] : value * powers[parts.exponent];
+			return parts.negative ? -value : value;
+		}
+
+		return FromChars(ptr, end);
+	}
 
-	struct JsonContext : std::enable_shared_from_this<JsonContext>
+	template <typename CharT>
+	static int64_t ToInt64(const CharT * ptr, const CharT * end)
 	{
-		const wchar_t * txt;
-		const wchar_t * end;
-		bool next;
-		std::stack<Json::State> current;
+		NumberParts parts(ptr, end);
+
+		if (!parts.integer)
+		{
+			throw std::invalid_argument("Not an integer.");
+		}
 
-		JsonContext(std::wstring_view json) : txt(json.data()), end(json.data() + json.size()), next(false)
+		const uint64_t limit = (uint64_t) std::numeric_limits<int64_t>::max() + (parts.negative ? 1 : 0);
+
+		if (parts.truncated || parts.mantissa > limit)
+		{
+			throw std::out_of_range("Number out of range.");
+		}
+
+		return parts.negative ? (int64_t) (0 - parts.mantissa) : (int64_t) parts.mantissa;
+	}
+
+
+	template <typename CharT>
+	struct JsonParser : JsonTokenizer<CharT>
+	{
+		using JsonTokenizer<CharT>::txt;
+		using JsonTokenizer<CharT>::end;
+		using JsonTokenizer<CharT>::SkipWhiteSpace;
+		using JsonTokenizer<CharT>::SkipWhiteSpaceTo;
+		using JsonTokenizer<CharT>::ParseString;
+		using JsonTokenizer<CharT>::QuotedString;
+		using JsonTokenizer<CharT>::UnquotedString;
+		using JsonTokenizer<CharT>::AtNumber;
+		using JsonTokenizer<CharT>::Number;
+		using JsonTokenizer<CharT>::Fail;
+
+		JsonContext & context;
+
+		JsonParser(JsonContext & context, JsonSource<CharT> & source) : JsonTokenizer<CharT>(source.txt, source.end), context(context)
 		{}
 
-		Json::Value Parse(size_t nested)
+		Json::ValueView ParseView(size_t nested)
 		{
 			if (SkipWhiteSpace())
 			{
 				switch (*txt++)
 				{
-				case L'{':
-					current.push(Json::State::Object), next = true;
+				case '{':
+					context.current.push(Json::State::Object), context.next = true;
 					return Json::State::Object;
 
-				case L'[':
-					current.push(Json::State::Array), next = true;
+				case '[':
+					context.current.push(Json::State::Array), context.next = true;
 					return Json::State::Array;
 
-				case L'}':
-				case L']':
-					current.pop(), next = false;
-					return (current.size() > nested) ? Json::State::Next : Json::State::End;
+				case '}':
+				case ']':
+					context.current.pop(), context.next = false;
+					return (context.current.size() > nested) ? Json::State::Next : Json::State::End;
 
-				case L',':
+				case ',':
 					return ParseNext(nested);
 
-				case L'"':
-					if (std::exchange(next, false))
+				case '"':
+					if (std::exchange(context.next, false))
 					{
 						--txt;
 						return ParseNext(nested);
@@ -122,31 +476,31 @@ namespace custard
 
 				default:
 					--txt;
-					if (std::exchange(next, false))
+					if (std::exchange(context.next, false))
 					{
 						return ParseNext(nested);
 					}
-					return UnquotedString();
+					return UnquotedValue();
 				}
 			}
 
 			return Json::State::End;
 		}
 
-		Json::Value ParseNext(size_t nested)
+		Json::ValueView ParseNext(size_t nested)
 		{
 			if (SkipWhiteSpace())
 			{
-				if (*txt == L'}' || *txt == L']')
+				if (*txt == '}' || *txt == ']')
 				{
 					++txt;
-					current.pop();
-					return (current.size() > nested) ? Json::State::Next : Json::State::End;
+					context.current.pop();
+					return (context.current.size() > nested) ? Json::State::Next : Json::State::End;
 				}
 
-				if (current.empty() || current.top() == Json::State::Array)
+				if (context.current.empty() || context.current.top() == Json::State::Array)
 				{
-					return Parse(nested);
+					return ParseView(nested);
 				}
 				else
 				{
@@ -157,132 +511,677 @@ namespace custard
 			return Json::State::End;
 		}
 
-		bool SkipWhiteSpace()
+		void Skip(size_t nested)
 		{
-			while (txt < end)
+			if (context.current.size() > nested)
 			{
-				if (iswgraph(*txt))
+				SkipNested(txt, context.current.size() - nested);
+
+				while (context.current.size() > nested)
 				{
-					return true;
+					context.current.pop();
 				}
 
-				++txt;
+				context.next = false;
+				return;
 			}
 
-			return false;
+			if (SkipWhiteSpace())
+			{
+				switch (*txt)
+				{
+				case ',':
+				case '}':
+				case ']':
+					// consumed already
+					break;
+
+				case '{':
+				case '[':
+					SkipNested(txt + 1, 1);
+					break;
+
+				case '"':
+					++txt;
+					QuotedString();
+					break;
+
+				default:
+					UnquotedString();
+					break;
+				}
+			}
 		}
 
-		bool SkipWhiteSpaceTo(wchar_t ch)
+		// Past the bracket that closes depth open levels. Text that ends before they all close is
+		// malformed, not the rest of the document.
+		void SkipNested(const CharT * from, size_t depth)
 		{
-			while (txt < end)
+			if (auto next = simd::SkipNested(from, end, depth))
 			{
-				if (*txt == ch)
-				{
-					return true;
-				}
+				txt = next;
+				return;
+			}
 
-				if (iswgraph(*txt))
-				{
-					return false;
-				}
+			txt = end;
+			Fail(JsonErrc::UnexpectedEnd);
+		}
 
+		bool NextElement()
+		{
+			if (SkipWhiteSpaceTo(','))
+			{
 				++txt;
+				context.next = false;
 			}
 
-			return false;
+			return SkipWhiteSpace() && *txt != ']';
 		}
 
-		std::pair<std::wstring, Json> ParseKeyValue()
+		std::pair<JsonString, Json> ParseKeyValue()
 		{
 			auto key = ParseString();
 
-			if (SkipWhiteSpaceTo(L':'))
+			if (SkipWhiteSpaceTo(':'))
 			{
 				++txt;
-				return { key, Json(shared_from_this()) };
+				return { std::move(key), Json(context) };
 			}
 
-			throw new std::invalid_argument("Key value pair expected.");
+			throw std::invalid_argument("Key value pair expected.");
 		}
 
-		std::wstring ParseString()
+		Json::ValueView UnquotedValue()
 		{
-			if (*txt == L'"')
+			if (AtNumber())
 			{
-				++txt;
-				return QuotedString();
+				return Number();
 			}
 
 			return UnquotedString();
 		}
+	};
 
-		std::wstring QuotedString()
+
+	class JsonErrorCategory : public std::error_category
+	{
+	public:
+		const char * name() const noexcept override
 		{
-			bool escape = false;
-			auto begin = txt;
+			return "json";
+		}
 
-			while (txt < end)
+		std::string message(int value) const override
+		{
+			switch ((JsonErrc) value)
 			{
-				if (*txt == L'"')
+			case JsonErrc::UnexpectedCharacter:
+				return "Unexpected character.";
+			case JsonErrc::UnexpectedEnd:
+				return "Unexpected end of text.";
+			case JsonErrc::UnterminatedString:
+				return "Unterminated string.";
+			case JsonErrc::InvalidEscape:
+				return "Invalid escape character.";
+			case JsonErrc::TooDeep:
+				return "Too deeply nested.";
+			default:
+				return "Unknown error.";
+			}
+		}
+	};
+
+	const std::error_category & JsonCategory() noexcept
+	{
+		static const JsonErrorCategory category;
+		return category;
+	}
+
+	void JsonError::Throw() const
+	{
+		auto message = code.message() + " (offset " + std::to_string(offset) + ")";
+
+		if (code == JsonErrc::TooDeep)
+		{
+			throw std::length_error(message);
+		}
+
+		throw std::invalid_argument(message);
+	}
+
+
+	void JsonStack::push(Json::State state)
+	{
+		if (m_size == m_maxDepth)
+		{
+			throw std::length_error("Too deeply nested.");
+		}
+
+		if (m_size < InlineDepth)
+		{
+			m_inline[m_size] = state;
+		}
+		else
+		{
+			m_overflow.push_back(state);
+		}
+
+		++m_size;
+	}
+
+	void JsonStack::pop()
+	{
+		if (m_size == 0)
+		{
+			throw std::invalid_argument("Unbalanced brackets.");
+		}
+
+		if (m_size > InlineDepth)
+		{
+			m_overflow.pop_back();
+		}
+
+		--m_size;
+	}
+
+
+	JsonContext::JsonContext(std::wstring_view text, size_t maxDepth, Resource resource) :
+		source(JsonSource<wchar_t>{ text.data(), text.data() + text.size() }), next(false), current(maxDepth, resource), resource(resource)
+	{}
+
+	JsonContext::JsonContext(std::u8string_view text, size_t maxDepth, Resource resource) :
+		source(JsonSource<char8_t>{ text.data(), text.data() + text.size() }), next(false), current(maxDepth, resource), resource(resource)
+	{}
+
+	JsonContext::JsonContext(std::span<const std::byte> data, size_t maxDepth, Resource resource) : JsonContext(SkipByteOrderMark(data), maxDepth, resource)
+	{}
+
+	Json::ValueView JsonContext::ParseView(size_t nested)
+	{
+		return std::visit([this, nested](auto & source) { return JsonParser(*this, source).ParseView(nested); }, source);
+	}
+
+	void JsonContext::Skip(size_t nested)
+	{
+		std::visit([this, nested](auto & source) { JsonParser(*this, source).Skip(nested); }, source);
+	}
+
+	bool JsonContext::NextElement()
+	{
+		return std::visit([this](auto & source) { return JsonParser(*this, source).NextElement(); }, source);
+	}
+
+	Json::Value JsonContext::Parse(size_t nested)
+	{
+		struct Materialize
+		{
+			Json::Value operator()(Json::State state)
+			{
+				return state;
+			}
+
+			Json::Value operator()(std::pair<JsonString, Json> && keyValue)
+			{
+				return std::pair<std::wstring, Json>(keyValue.first.Str(), std::move(keyValue.second));
+			}
+
+			Json::Value operator()(Json && value)
+			{
+				return std::move(value);
+			}
+
+			Json::Value operator()(JsonString && value)
+			{
+				return value.Str();
+			}
+
+			Json::Value operator()(JsonNumber && value)
+			{
+				return value;
+			}
+		};
+
+		return std::visit(Materialize(), ParseView(nested));
+	}
+
+
+	// Validation is the push parser with nothing to push to.
+	struct JsonNoEvents
+	{};
+
+	JsonError Json::Validate(std::wstring_view text, size_t maxDepth)
+	{
+		JsonNoEvents events;
+		return ParseJson(text, events, std::nothrow, maxDepth);
+	}
+
+	JsonError Json::Validate(std::u8string_view text, size_t maxDepth)
+	{
+		JsonNoEvents events;
+		return ParseJson(text, events, std::nothrow, maxDepth);
+	}
+
+	JsonError Json::Validate(std::span<const std::byte> data, size_t maxDepth)
+	{
+		JsonNoEvents events;
+		return ParseJson(data, events, std::nothrow, maxDepth);
+	}
+
+
+	Json::Json(JsonContext & context) : m_nested(context.current.size()), m_context(&context)
+	{}
+
+	Json::Json(std::wstring_view text) : m_nested(0), m_owner(std::make_unique<JsonContext>(text)), m_context(m_owner.get())
+	{}
+
+	Json::Json(std::u8string_view text) : m_nested(0), m_owner(std::make_unique<JsonContext>(text)), m_context(m_owner.get())
+	{}
+
+	Json::Json(std::span<const std::byte> data) : m_nested(0), m_owner(std::make_unique<JsonContext>(data)), m_context(m_owner.get())
+	{}
+
+	Json::Json(std::unique_ptr<JsonContext> owner) : m_nested(owner->current.size()), m_owner(std::move(owner)), m_context(m_owner.get())
+	{}
+
+	Json::~Json() noexcept
+	{}
+
+	Json::Value Json::Parse()
+	{
+		return m_context->Parse(m_nested);
+	}
+
+	Json::ValueView Json::ParseView()
+	{
+		return m_context->ParseView(m_nested);
+	}
+
+	void Json::Skip()
+	{
+		m_context->Skip(m_nested);
+	}
+
+	// The reference tokens of an RFC 6901 pointer, with "~1" and "~0" decoded.
+	static std::vector<std::wstring> SplitPointer(std::wstring_view pointer)
+	{
+		std::vector<std::wstring> tokens;
+
+		if (!pointer.empty() && pointer[0] != L'/')
+		{
+			throw std::invalid_argument("Invalid JSON pointer.");
+		}
+
+		while (!pointer.empty())
+		{
+			pointer.remove_prefix(1);
+
+			auto & token = tokens.emplace_back(pointer.substr(0, pointer.find(L'/')));
+			pointer.remove_prefix(token.size());
+
+			for (size_t pos = 0; (pos = token.find(L'~', pos)) != std::wstring::npos; ++pos)
+			{
+				if (pos + 1 == token.size() || (token[pos + 1] != L'0' && token[pos + 1] != L'1'))
+				{
+					throw std::invalid_argument("Invalid JSON pointer.");
+				}
+
+				token.replace(pos, 2, (token[pos + 1] == L'0') ? L"~" : L"/");
+			}
+		}
+
+		return tokens;
+	}
+
+	// An array index token, or -1 for anything else.
+	static size_t PointerIndex(std::wstring_view token)
+	{
+		if (token.empty() || token.size() > 9 || (token[0] == L'0' && token.size() > 1))
+		{
+			return (size_t) -1;
+		}
+
+		size_t index = 0;
+
+		for (auto ch : token)
+		{
+			if (ch < L'0' || ch > L'9')
+			{
+				return (size_t) -1;
+			}
+
+			index = index * 10 + (ch - L'0');
+		}
+
+		return index;
+	}
+
+	std::optional<Json> Json::Find(std::wstring_view pointer) &&
+	{
+		auto found = Find(pointer);
+
+		if (!found || !m_owner)
+		{
+			return found;
+		}
+
+		return Json(std::move(m_owner));
+	}
+
+	std::optional<Json> Json::Find(std::wstring_view pointer) &
+	{
+		for (auto & token : SplitPointer(pointer))
+		{
+			auto nested = m_context->current.size();
+			auto value = m_context->ParseView(nested);
+			auto state = std::get_if<State>(&value);
+			bool found = false;
+
+			if (state && *state == State::Object)
+			{
+				while (!found)
 				{
-					if (!escape)
+					auto next = m_context->ParseView(nested);
+					auto keyValue = std::get_if<std::pair<JsonString, Json>>(&next);
+
+					if (!keyValue)
 					{
-						return { begin, txt++ };
+						return std::nullopt;
 					}
 
-					return UnescapeString(begin, txt++);
+					if (!(found = (keyValue->first == token)))
+					{
+						keyValue->second.Skip();
+					}
 				}
+			}
+			else if (state && *state == State::Array)
+			{
+				auto index = PointerIndex(token);
 
-				if (*txt++ == L'\\')
+				for (size_t i = 0; !found && m_context->NextElement(); i++)
 				{
-					ValidateEscapeChar(*txt++);
-					escape = true;
+					if (!(found = (i == index)))
+					{
+						m_context->Skip(nested + 1);
+					}
 				}
 			}
 
-			throw new std::invalid_argument("Unterminated string.");
+			if (!found)
+			{
+				return std::nullopt;
+			}
 		}
 
-		std::wstring UnquotedString()
+		return Json(*m_context);
+	}
+
+	std::wstring Json::GetString()
+	{
+		auto value = Parse();
+
+		if (auto number = std::get_if<JsonNumber>(&value))
 		{
-			bool escape = false;
-			auto begin = txt;
+			return number->Str();
+		}
+
+		return std::get<std::wstring>(std::move(value));
+	}
 
-			while (txt < end)
+	std::wstring_view Json::GetStringView()
+	{
+		return std::get<JsonString>(ParseView()).View(m_context->resource);
+	}
+
+	JsonNumber Json::GetNumber()
+	{
+		auto value = ParseView();
+
+		if (auto text = std::get_if<JsonString>(&value))
+		{
+			return text->Number();
+		}
+
+		return std::get<JsonNumber>(value);
+	}
+
+
+	std::wstring_view JsonString::View()
+	{
+		if (auto text = std::get_if<std::wstring_view>(&m_text); text && !m_escaped)
+		{
+			return *text;
+		}
+
+		if (m_owned.empty())
+		{
+			m_owned = Str();
+		}
+
+		return m_owned;
+	}
+
+	std::wstring_view JsonString::View(std::pmr::memory_resource * resource) const
+	{
+		if (auto text = std::get_if<std::wstring_view>(&m_text); text && !m_escaped)
+		{
+			return *text;
+		}
+
+		return std::visit([this, resource](auto text)
+		{
+			auto buffer = (wchar_t *) resource->allocate(std::max<size_t>(text.size(), 1) * sizeof(wchar_t), alignof(wchar_t));
+			auto end = DecodeString(text.data(), text.data() + text.size(), m_escaped, buffer);
+
+			return std::wstring_view(buffer, end - buffer);
+		},
+		m_text);
+	}
+
+	std::wstring JsonString::Str() const
+	{
+		return std::visit([this](auto text)
+		{
+			std::wstring buff(text.size(), L'\0');
+			buff.resize(DecodeString(text.data(), text.data() + text.size(), m_escaped, buff.data()) - buff.data());
+			return buff;
+		},
+		m_text);
+	}
+
+	std::u8string JsonString::U8Str() const
+	{
+		return std::visit([this](auto text)
+		{
+			std::u8string buff((sizeof(text[0]) == 1) ? text.size() : MaxUtf8Length(text.size()), u8'\0');
+			buff.resize(DecodeString(text.data(), text.data() + text.size(), m_escaped, buff.data()) - buff.data());
+			return buff;
+		},
+		m_text);
+	}
+
+	bool JsonString::Compare(std::wstring_view other, bool prefix) const
+	{
+		if (auto text = std::get_if<std::wstring_view>(&m_text); text && !m_escaped)
+		{
+			return prefix ? text->starts_with(other) : (*text == other);
+		}
+
+		size_t pos = 0;
+		bool match = true;
+
+		std::visit([&](auto text)
+		{
+			ForEachUnit(text.data(), text.data() + text.size(), [&](wchar_t ch)
 			{
-				if (wcschr(LR"(,[]{})", *txt) || !iswgraph(*txt))
+				if (pos == other.size())
 				{
-					if (!escape)
-					{
-						return { begin, txt };
-					}
+					match = prefix;
+					return false;
+				}
+
+				if (other[pos++] != ch)
+				{
+					match = false;
+					return false;
+				}
+
+				return true;
+			});
+		},
+		m_text);
+
+		return match && pos == other.size();
+	}
+
+	uint32_t JsonString::Hash(uint32_t seed) const
+	{
+		if (auto text = std::get_if<std::wstring_view>(&m_text); text && !m_escaped)
+		{
+			return JsonHash(*text, seed);
+		}
+
+		uint32_t hash = JsonHash(std::wstring_view(), seed);
+
+		std::visit([&](auto text)
+		{
+			ForEachUnit(text.data(), text.data() + text.size(), [&](wchar_t ch)
+			{
+				hash = JsonHash(hash, ch);
+				return true;
+			});
+		},
+		m_text);
+
+		return hash;
+	}
+
+	JsonNumber JsonString::Number() const
+	{
+		if (m_escaped)
+		{
+			throw std::invalid_argument("Invalid number.");
+		}
+
+		return std::visit([](auto text) { return JsonNumber(text); }, m_text);
+	}
+
+
+	int64_t JsonNumber::Int64() const
+	{
+		return std::visit([](auto text) { return ToInt64(text.data(), text.data() + text.size()); }, m_text);
+	}
+
+	double JsonNumber::Double() const
+	{
+		return std::visit([](auto text) { return ToDouble(text.data(), text.data() + text.size()); }, m_text);
+	}
+
+	std::wstring JsonNumber::Str() const
+	{
+		return std::visit([](auto text) { return std::wstring(text.begin(), text.end()); }, m_text);
+	}
+
+
+	JsonQuery::JsonQuery(std::initializer_list<std::wstring_view> pointers) : m_steps(1, Step{ {}, None, None, {} })
+	{
+		size_t target = 0;
 
-					return UnescapeString(begin, txt);
+		for (auto pointer : pointers)
+		{
+			size_t step = 0;
+
+			for (auto & token : SplitPointer(pointer))
+			{
+				if (m_steps[step].target != None)
+				{
+					throw std::invalid_argument("Overlapping pointers in JsonQuery.");
 				}
 
-				if (*txt++ == L'\\')
+				auto & children = m_steps[step].children;
+				auto child = std::find_if(children.begin(), children.end(), [&](size_t i) { return m_steps[i].token == token; });
+
+				if (child != children.end())
 				{
-					ValidateEscapeChar(*txt++);
-					escape = true;
+					step = *child;
+					continue;
 				}
+
+				children.push_back(m_steps.size());
+				step = m_steps.size();
+				m_steps.push_back(Step{ token, PointerIndex(token), None, {} });
 			}
 
-			return { begin, end };
+			if (m_steps[step].target != None || !m_steps[step].children.empty())
+			{
+				throw std::invalid_argument("Overlapping pointers in JsonQuery.");
+			}
+
+			m_steps[step].target = target++;
 		}
-	};
+	}
 
+	void JsonQuery::Run(Json & json, const Found & found) const
+	{
+		Visit(*json.m_context, 0, found);
+	}
 
-	Json::Json(std::shared_ptr<JsonContext> context) : m_nested(context->current.size()), m_context(context)
-	{}
+	void JsonQuery::Visit(JsonContext & context, size_t step, const Found & found) const
+	{
+		auto & current = m_steps[step];
+		auto nested = context.current.size();
 
-	Json::Json(std::wstring_view text) : m_nested(0), m_context(std::make_shared<JsonContext>(text))
-	{}
+		if (current.target != None)
+		{
+			Json value(context);
+			found(current.target, value);
+			value.Skip();
+			return;
+		}
 
-	Json::~Json() noexcept
-	{}
+		auto value = context.ParseView(nested);
+		auto state = std::get_if<Json::State>(&value);
 
-	Json::Value Json::Parse()
-	{
-		return m_context->Parse(m_nested);
+		if (state && *state == Json::State::Object)
+		{
+			for (;;)
+			{
+				auto next = context.ParseView(nested);
+				auto keyValue = std::get_if<std::pair<JsonString, Json>>(&next);
+
+				if (!keyValue)
+				{
+					break;
+				}
+
+				auto child = std::find_if(current.children.begin(), current.children.end(), [&](size_t i) { return keyValue->first == m_steps[i].token; });
+
+				if (child != current.children.end())
+				{
+					Visit(context, *child, found);
+				}
+
+				keyValue->second.Skip();
+			}
+		}
+		else if (state && *state == Json::State::Array)
+		{
+			for (size_t index = 0; context.NextElement(); index++)
+			{
+				auto child = std::find_if(current.children.begin(), current.children.end(), [&](size_t i) { return m_steps[i].index == index; });
+
+				if (child != current.children.end())
+				{
+					Visit(context, *child, found);
+				}
+				else
+				{
+					context.Skip(nested + 1);
+				}
+			}
+
+			// the closing bracket
+			context.ParseView(nested);
+		}
 	}
 }
@@ -1,40 +1,328 @@
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
+#include <functional>
 #include <memory>
+#include <memory_resource>
+#include <optional>
+#include <span>
 #include <string>
 #include <string_view>
+#include <system_error>
 #include <type_traits>
 #include <utility>
 #include <variant>
+#include <vector>
 
 namespace custard
 {
 	struct JsonContext;
 
+	//
+	// Malformed text. Json::Validate() and the error-code form of ParseJson report these with the
+	// offset at which they were found; the other parsers throw them as std::invalid_argument, or as
+	// std::length_error for the limits.
+	//
+	enum class JsonErrc
+	{
+		UnexpectedCharacter = 1,
+		UnexpectedEnd,
+		UnterminatedString,
+		InvalidEscape,
+		TooDeep,
+	};
+
+	const std::error_category & JsonCategory() noexcept;
+
+	inline std::error_code make_error_code(JsonErrc errc) noexcept
+	{
+		return std::error_code((int) errc, JsonCategory());
+	}
+
+	struct JsonError
+	{
+		std::error_code code;
+		size_t offset = 0; // in code units from the start of the text, so in bytes for UTF-8
+
+		explicit operator bool() const noexcept
+		{
+			return (bool) code;
+		}
+
+		// Throws the exception the throwing parsers use for this error.
+		[[noreturn]] void Throw() const;
+	};
+
+	// FNV-1a over decoded code units. Constant so that known keys can be hashed at compile time.
+	constexpr uint32_t JsonHash(uint32_t hash, wchar_t ch) noexcept
+	{
+		return (hash ^ (uint32_t) ch) * 16777619u;
+	}
+
+	constexpr uint32_t JsonHash(std::wstring_view text, uint32_t seed) noexcept
+	{
+		uint32_t hash = JsonHash(2166136261u, (wchar_t) seed);
+
+		for (auto ch : text)
+		{
+			hash = JsonHash(hash, ch);
+		}
+
+		return hash;
+	}
+
+	//
+	// A number token as it appears in the source, converted only on demand.
+	//
+	class JsonNumber
+	{
+		std::variant<std::wstring_view, std::u8string_view> m_text;
+
+	public:
+		JsonNumber(std::wstring_view text) : m_text(text)
+		{}
+
+		JsonNumber(std::u8string_view text) : m_text(text)
+		{}
+
+		int64_t Int64() const;
+		double Double() const;
+
+		std::wstring Str() const;
+	};
+
+	//
+	// A string token as it appears in the source, decoded only on demand.
+	//
+	class JsonString
+	{
+		std::variant<std::wstring_view, std::u8string_view> m_text;
+		bool m_escaped;
+		std::wstring m_owned;
+
+	public:
+		JsonString(std::wstring_view text, bool escaped) : m_text(text), m_escaped(escaped)
+		{}
+
+		JsonString(std::u8string_view text, bool escaped) : m_text(text), m_escaped(escaped)
+		{}
+
+		// Unescaped wide text is a view into the source; anything else is decoded once and cached.
+		std::wstring_view View();
+
+		// As View(), but anything that needs decoding goes into memory from resource, which owns it.
+		std::wstring_view View(std::pmr::memory_resource * resource) const;
+
+		std::wstring Str() const;
+
+		// The decoded text as UTF-8. Unescaped runs of UTF-8 source are copied as they are.
+		std::u8string U8Str() const;
+
+		bool operator==(std::wstring_view other) const
+		{
+			return Compare(other, false);
+		}
+
+		bool starts_with(std::wstring_view other) const
+		{
+			return Compare(other, true);
+		}
+
+		// Same as JsonHash(View(), seed), without decoding into a buffer.
+		uint32_t Hash(uint32_t seed) const;
+
+		// The text as a number, for quoted numbers such as Slack timestamps.
+		JsonNumber Number() const;
+
+	private:
+		bool Compare(std::wstring_view other, bool prefix) const;
+	};
+
 	class Json
 	{
+		friend class JsonQuery;
+
 		const size_t m_nested;
-		std::shared_ptr<JsonContext> m_context;
+		std::unique_ptr<JsonContext> m_owner;
+		JsonContext * m_context;
 
 	public:
-		Json(std::shared_ptr<JsonContext> context);
+		// A cursor over the value at the current position of the context, which it does not own.
+		Json(JsonContext & context);
+
+		// A cursor that owns its own context.
 		Json(std::wstring_view text);
+		Json(std::u8string_view text);
+		Json(std::span<const std::byte> data);
+
+		Json(Json &&) noexcept = default;
 		~Json() noexcept;
 
+	private:
+		// A cursor at the current position of a context it takes over.
+		Json(std::unique_ptr<JsonContext> owner);
+
+	public:
+
+		static constexpr size_t DefaultMaxDepth = 1024;
+
+		// Checks that text is a whole document that ParseJson accepts, without decoding anything or
+		// throwing for malformed text. Returns the first error, if any.
+		static JsonError Validate(std::wstring_view text, size_t maxDepth = DefaultMaxDepth);
+		static JsonError Validate(std::u8string_view text, size_t maxDepth = DefaultMaxDepth);
+		static JsonError Validate(std::span<const std::byte> data, size_t maxDepth = DefaultMaxDepth);
+
 		enum State { Object, Array, Next, End };
-		using Value = std::variant<State, std::pair<std::wstring, Json>, Json, std::wstring>;
+		using Value = std::variant<State, std::pair<std::wstring, Json>, Json, std::wstring, JsonNumber>;
+		using ValueView = std::variant<State, std::pair<JsonString, Json>, Json, JsonString, JsonNumber>;
 
 		Value Parse();
+		ValueView ParseView();
+
+		// Moves past whatever is left of this value without decoding it.
+		void Skip();
+
+		// The value at an RFC 6901 pointer such as L"/bot/icons/image_48", relative to this value, which
+		// must not have been parsed yet. Everything before it is skipped; the cursor shares the context,
+		// or takes it over from a temporary that owns it, as in Json(text).Find(pointer).
+		std::optional<Json> Find(std::wstring_view pointer) &;
+		std::optional<Json> Find(std::wstring_view pointer) &&;
 
 		bool GetBool()
 		{
-			return std::get<std::wstring>(Parse()) == L"true";
+			return std::get<JsonString>(ParseView()) == L"true";
 		}
 
-		std::wstring GetString()
+		// Either a string or the text of a number.
+		std::wstring GetString();
+
+		// The string in the source or in the context's memory resource, without a heap allocation.
+		std::wstring_view GetStringView();
+
+		// Either a number or a string that holds one.
+		int64_t GetInt64()
+		{
+			return GetNumber().Int64();
+		}
+
+		double GetDouble()
 		{
-			return std::get<std::wstring>(Parse());
+			return GetNumber().Double();
 		}
+
+	private:
+		JsonNumber GetNumber();
+	};
+
+
+	template <typename CharT>
+	struct JsonSource
+	{
+		const CharT * txt;
+		const CharT * end;
+	};
+
+	//
+	// Nesting stack that only touches the heap beyond InlineDepth levels.
+	//
+	class JsonStack
+	{
+	public:
+		static constexpr size_t InlineDepth = 32;
+		static constexpr size_t DefaultMaxDepth = Json::DefaultMaxDepth;
+
+	private:
+		Json::State m_inline[InlineDepth];
+		std::pmr::vector<Json::State> m_overflow;
+		size_t m_size;
+		size_t m_maxDepth;
+
+	public:
+		JsonStack(size_t maxDepth, std::pmr::memory_resource * resource = std::pmr::get_default_resource()) noexcept :
+			m_overflow(resource), m_size(0), m_maxDepth(maxDepth)
+		{}
+
+		bool empty() const noexcept
+		{
+			return m_size == 0;
+		}
+
+		size_t size() const noexcept
+		{
+			return m_size;
+		}
+
+		Json::State top() const noexcept
+		{
+			return (m_size > InlineDepth) ? m_overflow.back() : m_inline[m_size - 1];
+		}
+
+		void push(Json::State state);
+		void pop();
+	};
+
+	//
+	// Parser state shared by a Json cursor and its children. It may live on the stack, in which case
+	// a parse does not allocate anything but the strings it materializes; it must outlive every
+	// cursor over it, as must the source text.
+	//
+	// Deep nesting and GetStringView draw on resource, so that with a monotonic arena everything a
+	// parse produces is released at once with the arena.
+	//
+	struct JsonContext
+	{
+		std::variant<JsonSource<wchar_t>, JsonSource<char8_t>> source;
+		bool next;
+		JsonStack current;
+		std::pmr::memory_resource * resource;
+
+		using Resource = std::pmr::memory_resource *;
+
+		JsonContext(std::wstring_view text, size_t maxDepth = JsonStack::DefaultMaxDepth, Resource resource = std::pmr::get_default_resource());
+		JsonContext(std::u8string_view text, size_t maxDepth = JsonStack::DefaultMaxDepth, Resource resource = std::pmr::get_default_resource());
+		JsonContext(std::span<const std::byte> data, size_t maxDepth = JsonStack::DefaultMaxDepth, Resource resource = std::pmr::get_default_resource());
+
+		JsonContext(const JsonContext &) = delete;
+		JsonContext & operator=(const JsonContext &) = delete;
+
+		Json::Value Parse(size_t nested);
+		Json::ValueView ParseView(size_t nested);
+		void Skip(size_t nested);
+
+		// Moves past the comma before the next array element; false at the end of the array.
+		bool NextElement();
+	};
+
+	//
+	// Several pointers compiled into a tree, so that one pass over a document finds all of them and
+	// skips every other subtree. Each value is handed to one callback, so pointers may not repeat or
+	// be a prefix of one another, as L"/bot" and L"/bot/name" are; the constructor throws for those.
+	//
+	class JsonQuery
+	{
+		static constexpr size_t None = (size_t) -1;
+
+		struct Step
+		{
+			std::wstring token;
+			size_t index;
+			size_t target;
+			std::vector<size_t> children;
+		};
+
+		std::vector<Step> m_steps;
+
+	public:
+		using Found = std::function<void(size_t, Json &)>;
+
+		JsonQuery(std::initializer_list<std::wstring_view> pointers);
+
+		// Calls found with the position of each pointer in the list that matches, in document order.
+		void Run(Json & json, const Found & found) const;
+
+	private:
+		void Visit(JsonContext & context, size_t step, const Found & found) const;
 	};
 
 
@@ -47,6 +335,7 @@ namespace custard
 		JsonVisitor(T & visitor) : m_visitor(visitor)
 		{}
 
+		// Values the visitor leaves alone are skipped, so their contents never reach it.
 		bool operator()(std::pair<std::wstring, Json> && keyValue)
 		{
 			if constexpr (std::is_invocable_v<T, std::wstring &&, Json &&>)
@@ -54,6 +343,22 @@ namespace custard
 				m_visitor(std::move(std::get<0>(keyValue)), std::move(std::get<1>(keyValue)));
 			}
 
+			std::get<1>(keyValue).Skip();
+			return true;
+		}
+
+		bool operator()(std::pair<JsonString, Json> && keyValue)
+		{
+			if constexpr (std::is_invocable_v<T, JsonString &&, Json &&>)
+			{
+				m_visitor(std::move(std::get<0>(keyValue)), std::move(std::get<1>(keyValue)));
+			}
+			else if constexpr (std::is_invocable_v<T, std::wstring &&, Json &&>)
+			{
+				m_visitor(std::get<0>(keyValue).Str(), std::move(std::get<1>(keyValue)));
+			}
+
+			std::get<1>(keyValue).Skip();
 			return true;
 		}
 
@@ -77,6 +382,34 @@ namespace custard
 			return true;
 		}
 
+		bool operator()(JsonString && value)
+		{
+			if constexpr (std::is_invocable_v<T, JsonString &&>)
+			{
+				m_visitor(std::move(value));
+			}
+			else if constexpr (std::is_invocable_v<T, std::wstring &&>)
+			{
+				m_visitor(value.Str());
+			}
+
+			return true;
+		}
+
+		bool operator()(JsonNumber && value)
+		{
+			if constexpr (std::is_invocable_v<T, JsonNumber &&>)
+			{
+				m_visitor(std::move(value));
+			}
+			else if constexpr (std::is_invocable_v<T, std::wstring &&>)
+			{
+				m_visitor(value.Str());
+			}
+
+			return true;
+		}
+
 		bool operator()(Json::State state)
 		{
 			return (state != Json::State::End);
@@ -86,6 +419,18 @@ namespace custard
 	template <typename T>
 	inline void VisitJson(T & visitor, Json & json)
 	{
-		while (std::visit(JsonVisitor<T>(visitor), json.Parse())) /**/;
+		// Visitors that take JsonString or JsonNumber tokens see them in place, without materializing.
+		if constexpr (std::is_invocable_v<T, JsonString &&, Json &&> || std::is_invocable_v<T, JsonString &&> || std::is_invocable_v<T, JsonNumber &&>)
+		{
+			while (std::visit(JsonVisitor<T>(visitor), json.ParseView())) /**/;
+		}
+		else
+		{
+			while (std::visit(JsonVisitor<T>(visitor), json.Parse())) /**/;
+		}
 	}
 }
+
+template <>
+struct std::is_error_code_enum<custard::JsonErrc> : std::true_type
+{};
@@ -0,0 +1,35 @@
+#include "jsonlines.h"
+
+#include <cstring>
+
+namespace custard
+{
+	std::vector<std::span<const std::byte>> SplitJsonLines(std::span<const std::byte> data)
+	{
+		std::vector<std::span<const std::byte>> lines;
+
+		auto ptr = data.data();
+		auto end = ptr + data.size();
+
+		while (ptr < end)
+		{
+			// A line break never occurs inside a document, since strings must escape it.
+			auto next = (const std::byte *) std::memchr(ptr, '\n', end - ptr);
+			auto last = next ? next : end;
+
+			if (last > ptr && last[-1] == std::byte('\r'))
+			{
+				--last;
+			}
+
+			if (std::any_of(ptr, last, [](std::byte b) { return b > std::byte(' '); }))
+			{
+				lines.emplace_back(ptr, last);
+			}
+
+			ptr = next ? next + 1 : end;
+		}
+
+		return lines;
+	}
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include "json.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <span>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace custard
+{
+	// The documents of newline-delimited JSON, without their line breaks. Blank lines are dropped.
+	std::vector<std::span<const std::byte>> SplitJsonLines(std::span<const std::byte> data);
+
+	//
+	// Parses every document of newline-delimited JSON, e.g. the bytes of a MappedFile, on a pool of
+	// threads and returns what parse made of each in document order. parse is called concurrently
+	// and must be safe to call so; each thread claims batches of consecutive lines, so the results
+	// of one batch are written by one thread. The first exception thrown stops the pool and is
+	// rethrown here.
+	//
+	template <typename Parse>
+	auto ParseJsonLines(std::span<const std::byte> data, Parse && parse, size_t threads = 0)
+	{
+		using Result = std::invoke_result_t<Parse &, Json &>;
+
+		// std::vector<bool> packs its elements, so threads could not write them independently.
+		static_assert(!std::is_same_v<Result, bool>, "Wrap bool results in a struct.");
+
+		constexpr size_t Batch = 64;
+
+		auto lines = SplitJsonLines(data);
+		std::vector<Result> results(lines.size());
+
+		std::atomic<size_t> next = 0;
+		std::exception_ptr error;
+		std::mutex mutex;
+
+		auto worker = [&]()
+		{
+			try
+			{
+				for (size_t begin; (begin = next.fetch_add(Batch)) < lines.size(); )
+				{
+					for (size_t i = begin, end = std::min(begin + Batch, lines.size()); i < end; i++)
+					{
+						JsonContext context(lines[i]);
+						Json json(context);
+						results[i] = parse(json);
+					}
+				}
+			}
+			catch (...)
+			{
+				std::lock_guard lock(mutex);
+
+				if (!error)
+				{
+					error = std::current_exception();
+				}
+
+				next = lines.size();
+			}
+		};
+
+		if (threads == 0)
+		{
+			threads = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+		}
+
+		threads = std::min(threads, (lines.size() + Batch - 1) / Batch);
+
+		std::vector<std::thread> pool;
+
+		for (size_t i = 1; i < threads; i++)
+		{
+			pool.emplace_back(worker);
+		}
+
+		worker();
+
+		for (auto & thread : pool)
+		{
+			thread.join();
+		}
+
+		if (error)
+		{
+			std::rethrow_exception(error);
+		}
+
+		return results;
+	}
+}
@@ -0,0 +1,340 @@
+#pragma once
+
+#include "json.h"
+#include "jsontokenizer.h"
+
+#include <cstddef>
+#include <new>
+#include <span>
+#include <stdexcept>
+#include <string_view>
+#include <utility>
+
+namespace custard
+{
+	//
+	// Calls the handler's member functions, where it has them, for each token of a document:
+	//
+	//   OnBeginObject(), OnEndObject(), OnBeginArray(), OnEndArray(),
+	//   OnKey(JsonString &&), OnString(JsonString &&), OnNumber(JsonNumber &&), OnBool(bool), OnNull()
+	//
+	// The parser is instantiated for each handler, so these calls inline into the tokenizer loop and
+	// no cursors or variants are built. Tokens refer to the source text.
+	//
+	// ParseJson throws for malformed text; given std::nothrow it returns the error with its offset.
+	//
+	template <typename Handler>
+	struct JsonSaxEvents
+	{
+		Handler & handler;
+
+		void BeginObject()
+		{
+			if constexpr (requires { handler.OnBeginObject(); })
+			{
+				handler.OnBeginObject();
+			}
+		}
+
+		void EndObject()
+		{
+			if constexpr (requires { handler.OnEndObject(); })
+			{
+				handler.OnEndObject();
+			}
+		}
+
+		void BeginArray()
+		{
+			if constexpr (requires { handler.OnBeginArray(); })
+			{
+				handler.OnBeginArray();
+			}
+		}
+
+		void EndArray()
+		{
+			if constexpr (requires { handler.OnEndArray(); })
+			{
+				handler.OnEndArray();
+			}
+		}
+
+		void Key(JsonString && key)
+		{
+			if constexpr (requires { handler.OnKey(std::move(key)); })
+			{
+				handler.OnKey(std::move(key));
+			}
+		}
+
+		void String(JsonString && value)
+		{
+			if constexpr (requires { handler.OnString(std::move(value)); })
+			{
+				handler.OnString(std::move(value));
+			}
+		}
+
+		void Number(JsonNumber && value)
+		{
+			if constexpr (requires { handler.OnNumber(std::move(value)); })
+			{
+				handler.OnNumber(std::move(value));
+			}
+		}
+
+		void Bool(bool value)
+		{
+			if constexpr (requires { handler.OnBool(value); })
+			{
+				handler.OnBool(value);
+			}
+		}
+
+		void Null()
+		{
+			if constexpr (requires { handler.OnNull(); })
+			{
+				handler.OnNull();
+			}
+		}
+	};
+
+	//
+	// The error-code form: malformed text stops the parse with the first error instead of throwing it.
+	// Exceptions thrown by the handler still propagate.
+	//
+	template <typename CharT, typename Handler>
+	JsonError ParseJson(const CharT * begin, const CharT * end, Handler & handler, size_t maxDepth, std::nothrow_t)
+	{
+		enum class Expect { Value, ValueOrClose, Key, KeyOrClose, Colon, CommaOrClose, Done };
+
+		const CharT * txt = begin;
+		JsonTokenizer<CharT, false> tokenizer(txt, end);
+		JsonSaxEvents<Handler> events{ handler };
+		JsonStack stack(maxDepth);
+		Expect expect = Expect::Value;
+
+		auto fail = [&](JsonErrc errc)
+		{
+			return JsonError{ make_error_code(errc), (size_t) (txt - begin) };
+		};
+
+		while (tokenizer.SkipWhiteSpace())
+		{
+			const bool value = (expect == Expect::Value || expect == Expect::ValueOrClose);
+
+			switch (auto ch = *txt)
+			{
+			case '{':
+			case '[':
+				if (!value)
+				{
+					break;
+				}
+
+				if (stack.size() == maxDepth)
+				{
+					return fail(JsonErrc::TooDeep);
+				}
+
+				++txt;
+
+				if (ch == '{')
+				{
+					stack.push(Json::State::Object);
+					expect = Expect::KeyOrClose;
+					events.BeginObject();
+				}
+				else
+				{
+					stack.push(Json::State::Array);
+					expect = Expect::ValueOrClose;
+					events.BeginArray();
+				}
+				continue;
+
+			case '}':
+			case ']':
+				if (expect != Expect::CommaOrClose && expect != ((ch == '}') ? Expect::KeyOrClose : Expect::ValueOrClose))
+				{
+					break;
+				}
+
+				if (stack.top() != ((ch == '}') ? Json::State::Object : Json::State::Array))
+				{
+					break;
+				}
+
+				++txt;
+				stack.pop();
+				expect = stack.empty() ? Expect::Done : Expect::CommaOrClose;
+
+				if (ch == '}')
+				{
+					events.EndObject();
+				}
+				else
+				{
+					events.EndArray();
+				}
+				continue;
+
+			case ',':
+				if (expect != Expect::CommaOrClose)
+				{
+					break;
+				}
+
+				++txt;
+				expect = (stack.top() == Json::State::Object) ? Expect::Key : Expect::Value;
+				continue;
+
+			case ':':
+				if (expect != Expect::Colon)
+				{
+					break;
+				}
+
+				++txt;
+				expect = Expect::Value;
+				continue;
+
+			default:
+				if (expect == Expect::Key || expect == Expect::KeyOrClose)
+				{
+					auto key = tokenizer.ParseString();
+
+					if (tokenizer.error != JsonErrc{})
+					{
+						return fail(tokenizer.error);
+					}
+
+					events.Key(std::move(key));
+					expect = Expect::Colon;
+					continue;
+				}
+
+				if (!value)
+				{
+					break;
+				}
+
+				auto start = txt;
+
+				if (ch == '"')
+				{
+					++txt;
+
+					auto text = tokenizer.QuotedString();
+
+					if (tokenizer.error != JsonErrc{})
+					{
+						return fail(tokenizer.error);
+					}
+
+					events.String(std::move(text));
+				}
+				else if (tokenizer.AtNumber())
+				{
+					auto number = tokenizer.Number();
+
+					if (tokenizer.error != JsonErrc{})
+					{
+						return fail(tokenizer.error);
+					}
+
+					events.Number(std::move(number));
+				}
+				else if (auto token = tokenizer.UnquotedString(); tokenizer.error != JsonErrc{})
+				{
+					return fail(tokenizer.error);
+				}
+				else if (token == L"true" || token == L"false")
+				{
+					events.Bool(token == L"true");
+				}
+				else if (token == L"null")
+				{
+					events.Null();
+				}
+				else
+				{
+					// Unquoted values are only the literals, as JsonTape and the decoders have them.
+					txt = start;
+					return fail(JsonErrc::UnexpectedCharacter);
+				}
+
+				expect = stack.empty() ? Expect::Done : Expect::CommaOrClose;
+				continue;
+			}
+
+			return fail(JsonErrc::UnexpectedCharacter);
+		}
+
+		if (expect != Expect::Done)
+		{
+			return fail(JsonErrc::UnexpectedEnd);
+		}
+
+		return {};
+	}
+
+	template <typename Handler>
+	inline JsonError ParseJson(std::wstring_view text, Handler & handler, std::nothrow_t, size_t maxDepth = JsonStack::DefaultMaxDepth)
+	{
+		return ParseJson(text.data(), text.data() + text.size(), handler, maxDepth, std::nothrow);
+	}
+
+	template <typename Handler>
+	inline JsonError ParseJson(std::u8string_view text, Handler & handler, std::nothrow_t, size_t maxDepth = JsonStack::DefaultMaxDepth)
+	{
+		return ParseJson(text.data(), text.data() + text.size(), handler, maxDepth, std::nothrow);
+	}
+
+	// Offsets count from the start of data, byte order mark included.
+	template <typename Handler>
+	inline JsonError ParseJson(std::span<const std::byte> data, Handler & handler, std::nothrow_t, size_t maxDepth = JsonStack::DefaultMaxDepth)
+	{
+		auto text = SkipByteOrderMark(data);
+		auto error = ParseJson(text, handler, std::nothrow, maxDepth);
+
+		if (error)
+		{
+			error.offset += (const std::byte *) text.data() - data.data();
+		}
+
+		return error;
+	}
+
+	template <typename CharT, typename Handler>
+	void ParseJson(const CharT * txt, const CharT * end, Handler & handler, size_t maxDepth = JsonStack::DefaultMaxDepth)
+	{
+		if (auto error = ParseJson(txt, end, handler, maxDepth, std::nothrow))
+		{
+			error.Throw();
+		}
+	}
+
+	template <typename Handler>
+	inline void ParseJson(std::wstring_view text, Handler & handler, size_t maxDepth = JsonStack::DefaultMaxDepth)
+	{
+		ParseJson(text.data(), text.data() + text.size(), handler, maxDepth);
+	}
+
+	template <typename Handler>
+	inline void ParseJson(std::u8string_view text, Handler & handler, size_t maxDepth = JsonStack::DefaultMaxDepth)
+	{
+		ParseJson(text.data(), text.data() + text.size(), handler, maxDepth);
+	}
+
+	template <typename Handler>
+	inline void ParseJson(std::span<const std::byte> data, Handler & handler, size_t maxDepth = JsonStack::DefaultMaxDepth)
+	{
+		if (auto error = ParseJson(data, handler, std::nothrow, maxDepth))
+		{
+			error.Throw();
+		}
+	}
+}
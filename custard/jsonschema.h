@@ -0,0 +1,248 @@
+#pragma once
+
+#include "json.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+namespace custard
+{
+	//
+	// Declarative binding of JSON objects to structs. Specialize JsonSchema for a struct with a
+	// constant tuple of its fields, then fill it with BindJson:
+	//
+	//   template <> struct JsonSchema<Icons>
+	//   {
+	//       static constexpr auto Fields = std::make_tuple(JsonField(L"image_36", &Icons::image_36), ...);
+	//   };
+	//
+	// Keys are dispatched through a perfect hash built at compile time; unknown keys are skipped.
+	// std::wstring_view members refer to the source or to the JsonContext's memory resource, so a
+	// struct bound with an arena holds no heap memory of its own.
+	//
+
+	template <typename T, typename M>
+	struct JsonField
+	{
+		std::wstring_view name;
+		M T::* member;
+
+		constexpr JsonField(std::wstring_view name, M T::* member) noexcept : name(name), member(member)
+		{}
+	};
+
+	template <typename T>
+	struct JsonSchema;
+
+	template <typename T>
+	inline void BindJson(T & object, Json & json);
+
+	// Members that JsonSchema binds as nested objects rather than reading as a single value.
+	template <typename M>
+	constexpr bool IsJsonObject = !(std::is_arithmetic_v<M> ||
+		std::is_same_v<M, std::wstring> || std::is_same_v<M, std::wstring_view> || std::is_same_v<M, std::pmr::wstring>);
+
+	//
+	// Reads the start of a value bound to a struct. Returns false for null, which leaves the member as
+	// it is, and for any other value but an object when the member is optional; throws otherwise. The
+	// caller skips whatever is left of the value, so it never takes over the parent's keys.
+	//
+	inline bool OpenJsonObject(Json & value, bool optional)
+	{
+		auto token = value.ParseView();
+
+		if (auto state = std::get_if<Json::State>(&token); state && *state == Json::State::Object)
+		{
+			return true;
+		}
+
+		if (auto text = std::get_if<JsonString>(&token); (text && *text == L"null") || optional)
+		{
+			return false;
+		}
+
+		throw std::invalid_argument("Object expected.");
+	}
+
+
+	template <typename T>
+	class JsonBinder;
+
+	template <typename T>
+	struct IsOptional : std::false_type
+	{};
+
+	template <typename T>
+	struct IsOptional<std::optional<T>> : std::true_type
+	{};
+
+	template <typename M>
+	inline void AssignJson(M & member, Json & value)
+	{
+		if constexpr (IsOptional<M>::value)
+		{
+			if constexpr (IsJsonObject<typename M::value_type>)
+			{
+				if (OpenJsonObject(value, true))
+				{
+					JsonBinder<typename M::value_type> binder(member.emplace());
+					VisitJson(binder, value);
+				}
+			}
+			else
+			{
+				AssignJson(member.emplace(), value);
+			}
+		}
+		else if constexpr (std::is_same_v<M, bool>)
+		{
+			member = value.GetBool();
+		}
+		else if constexpr (std::is_integral_v<M>)
+		{
+			member = (M) value.GetInt64();
+		}
+		else if constexpr (std::is_floating_point_v<M>)
+		{
+			member = (M) value.GetDouble();
+		}
+		else if constexpr (std::is_same_v<M, std::wstring>)
+		{
+			member = value.GetString();
+		}
+		else if constexpr (std::is_same_v<M, std::wstring_view>)
+		{
+			member = value.GetStringView();
+		}
+		else if constexpr (std::is_same_v<M, std::pmr::wstring>)
+		{
+			member.assign(value.GetStringView());
+		}
+		else if (OpenJsonObject(value, false))
+		{
+			JsonBinder<M> binder(member);
+			VisitJson(binder, value);
+		}
+	}
+
+
+	template <typename T>
+	class JsonKeyTable
+	{
+		static constexpr auto & Fields = JsonSchema<T>::Fields;
+		static constexpr size_t Count = std::tuple_size_v<std::remove_cvref_t<decltype(Fields)>>;
+
+		static_assert(Count > 0 && Count < 256);
+
+	public:
+		// Twice as many slots as fields keeps the seed search short.
+		static constexpr size_t Size = std::bit_ceil(Count * 2);
+
+		uint32_t seed = 0;
+		uint8_t slots[Size] = {}; // field index + 1, or 0 when empty
+
+		static constexpr JsonKeyTable Build()
+		{
+			auto names = std::apply([](const auto & ... field)
+			{
+				return std::array<std::wstring_view, Count>{ field.name... };
+			},
+			Fields);
+
+			for (size_t i = 0; i < Count; i++)
+			{
+				for (size_t j = i + 1; j < Count; j++)
+				{
+					if (names[i] == names[j])
+					{
+						throw "Duplicate key in JsonSchema.";
+					}
+				}
+			}
+
+			for (JsonKeyTable table;; table.seed++)
+			{
+				std::fill(std::begin(table.slots), std::end(table.slots), uint8_t(0));
+
+				size_t i = 0;
+
+				for (; i < Count; i++)
+				{
+					auto & slot = table.slots[JsonHash(names[i], table.seed) & (Size - 1)];
+
+					if (slot)
+					{
+						break;
+					}
+
+					slot = (uint8_t) (i + 1);
+				}
+
+				if (i == Count)
+				{
+					return table;
+				}
+			}
+		}
+
+		template <size_t I>
+		static void Assign(T & object, JsonString & key, Json & value)
+		{
+			const auto & field = std::get<I>(Fields);
+
+			if (key == field.name)
+			{
+				AssignJson(object.*(field.member), value);
+			}
+		}
+
+		static void Dispatch(T & object, JsonString & key, Json & value)
+		{
+			static constexpr JsonKeyTable table = Build();
+
+			static constexpr auto assigners = []<size_t... I>(std::index_sequence<I...>)
+			{
+				return std::array<void (*)(T &, JsonString &, Json &), Count>{ &Assign<I>... };
+			}
+			(std::make_index_sequence<Count>());
+
+			if (auto slot = table.slots[key.Hash(table.seed) & (Size - 1)])
+			{
+				assigners[slot - 1](object, key, value);
+			}
+		}
+	};
+
+	template <typename T>
+	class JsonBinder
+	{
+		T & m_object;
+
+	public:
+		JsonBinder(T & object) : m_object(object)
+		{}
+
+		void operator()(JsonString && key, Json && value)
+		{
+			JsonKeyTable<T>::Dispatch(m_object, key, value);
+		}
+	};
+
+	template <typename T>
+	inline void BindJson(T & object, Json & json)
+	{
+		JsonBinder<T> binder(object);
+		VisitJson(binder, json);
+	}
+}
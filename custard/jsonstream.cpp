@@ -0,0 +1,234 @@
+#include "jsonstream.h"
+#include "simd.h"
+
+#include <stdexcept>
+#include <utility>
+
+namespace custard
+{
+	JsonStream::JsonStream(Callback callback, size_t maxDepth) :
+		m_callback(std::move(callback)), m_stack(maxDepth), m_expect(Expect::Value), m_token(Token::None), m_escaped(false), m_escapePending(false)
+	{}
+
+	void JsonStream::Feed(const std::byte * data, size_t size)
+	{
+		auto ptr = (const char8_t *) data;
+		auto end = ptr + size;
+
+		while (ptr < end)
+		{
+			switch (m_token)
+			{
+			case Token::Key:
+			case Token::String:
+				ptr = ScanString(ptr, end);
+				break;
+
+			case Token::Scalar:
+				ptr = ScanScalar(ptr, end);
+				break;
+
+			default:
+				if ((ptr = simd::SkipWhiteSpace(ptr, end)) < end)
+				{
+					ptr = Structural(ptr);
+				}
+				break;
+			}
+		}
+	}
+
+	void JsonStream::Finish()
+	{
+		if (m_token == Token::Scalar && !m_escapePending)
+		{
+			Emit(m_pending);
+		}
+
+		if (m_token != Token::None || !m_stack.empty())
+		{
+			throw std::invalid_argument("Unexpected end of text.");
+		}
+	}
+
+	const char8_t * JsonStream::Structural(const char8_t * ptr)
+	{
+		const bool value = (m_expect == Expect::Value || m_expect == Expect::ValueOrClose);
+
+		switch (auto ch = *ptr++)
+		{
+		case '{':
+		case '[':
+			if (value)
+			{
+				auto state = (ch == '{') ? Json::State::Object : Json::State::Array;
+
+				m_stack.push(state);
+				m_expect = (ch == '{') ? Expect::KeyOrClose : Expect::ValueOrClose;
+				m_callback(state);
+				return ptr;
+			}
+			break;
+
+		case '}':
+		case ']':
+			if (m_expect == Expect::CommaOrClose || m_expect == ((ch == '}') ? Expect::KeyOrClose : Expect::ValueOrClose))
+			{
+				if (m_stack.top() == ((ch == '}') ? Json::State::Object : Json::State::Array))
+				{
+					m_stack.pop();
+					m_expect = m_stack.empty() ? Expect::Value : Expect::CommaOrClose;
+					m_callback(m_stack.empty() ? Json::State::End : Json::State::Next);
+					return ptr;
+				}
+			}
+			break;
+
+		case ',':
+			if (m_expect == Expect::CommaOrClose)
+			{
+				m_expect = (m_stack.top() == Json::State::Object) ? Expect::Key : Expect::Value;
+				return ptr;
+			}
+			break;
+
+		case ':':
+			if (m_expect == Expect::Colon)
+			{
+				m_expect = Expect::Value;
+				return ptr;
+			}
+			break;
+
+		case '"':
+			if (m_expect == Expect::Key || m_expect == Expect::KeyOrClose)
+			{
+				m_token = Token::Key;
+				return ptr;
+			}
+			if (value)
+			{
+				m_token = Token::String;
+				return ptr;
+			}
+			break;
+
+		default:
+			if (value)
+			{
+				m_token = Token::Scalar;
+				return ptr - 1;
+			}
+			break;
+		}
+
+		throw std::invalid_argument("Unexpected character.");
+	}
+
+	const char8_t * JsonStream::ScanString(const char8_t * ptr, const char8_t * end)
+	{
+		auto begin = ptr;
+
+		// The previous chunk ended with a backslash.
+		if (std::exchange(m_escapePending, false))
+		{
+			++ptr;
+		}
+
+		while ((ptr = simd::FindQuoteOrEscape(ptr, end)) < end)
+		{
+			if (*ptr == '"')
+			{
+				if (m_pending.empty())
+				{
+					Emit({ begin, ptr });
+				}
+				else
+				{
+					m_pending.append(begin, ptr);
+					Emit(m_pending);
+				}
+
+				return ptr + 1;
+			}
+
+			m_escaped = true;
+
+			if ((ptr += 2) > end)
+			{
+				m_escapePending = true;
+				break;
+			}
+		}
+
+		m_pending.append(begin, end);
+		return end;
+	}
+
+	const char8_t * JsonStream::ScanScalar(const char8_t * ptr, const char8_t * end)
+	{
+		auto begin = ptr;
+
+		if (std::exchange(m_escapePending, false))
+		{
+			++ptr;
+		}
+
+		while ((ptr = simd::FindDelimiter(ptr, end)) < end)
+		{
+			if (*ptr != '\\')
+			{
+				if (m_pending.empty())
+				{
+					Emit({ begin, ptr });
+				}
+				else
+				{
+					m_pending.append(begin, ptr);
+					Emit(m_pending);
+				}
+
+				// The delimiter itself is left to Structural.
+				return ptr;
+			}
+
+			m_escaped = true;
+
+			if ((ptr += 2) > end)
+			{
+				m_escapePending = true;
+				break;
+			}
+		}
+
+		m_pending.append(begin, end);
+		return end;
+	}
+
+	void JsonStream::Emit(std::u8string_view text)
+	{
+		auto token = std::exchange(m_token, Token::None);
+		auto escaped = std::exchange(m_escaped, false);
+
+		if (token == Token::Key)
+		{
+			m_expect = Expect::Colon;
+			m_callback(Key{ JsonString(text, escaped) });
+		}
+		else
+		{
+			m_expect = m_stack.empty() ? Expect::Value : Expect::CommaOrClose;
+
+			if (token == Token::Scalar && !escaped && (text[0] == '-' || (text[0] >= '0' && text[0] <= '9')))
+			{
+				m_callback(JsonNumber(text));
+			}
+			else
+			{
+				m_callback(JsonString(text, escaped));
+			}
+		}
+
+		m_pending.clear();
+	}
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "json.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <variant>
+
+namespace custard
+{
+	//
+	// Push-fed counterpart of Json for UTF-8 text that arrives in chunks, e.g. from Response::Recv.
+	// Chunks may split the text anywhere, including inside an escape sequence or a UTF-8 sequence.
+	//
+	// Events follow Json::ParseView: Object and Array on open brackets, Next or End on close brackets,
+	// then a Key for each member name and a JsonString or JsonNumber for each scalar. The tokens refer
+	// to the chunk or to an internal buffer and are only valid during the callback.
+	//
+	class JsonStream
+	{
+	public:
+		struct Key
+		{
+			JsonString name;
+		};
+
+		using Event = std::variant<Json::State, Key, JsonString, JsonNumber>;
+		using Callback = std::function<void(Event &&)>;
+
+		JsonStream(Callback callback, size_t maxDepth = JsonStack::DefaultMaxDepth);
+		~JsonStream() noexcept = default;
+
+		JsonStream(const JsonStream &) = delete;
+		JsonStream & operator=(const JsonStream &) = delete;
+
+		void Feed(const std::byte * data, size_t size);
+
+		// Completes a trailing scalar and throws if the text is incomplete.
+		void Finish();
+
+		// Lets std::ref(stream) be handed to Response::Recv.
+		void operator()(std::byte * data, uint32_t size)
+		{
+			Feed(data, size);
+		}
+
+	private:
+		enum class Expect { Value, ValueOrClose, Key, KeyOrClose, Colon, CommaOrClose };
+		enum class Token { None, Key, String, Scalar };
+
+		Callback m_callback;
+		JsonStack m_stack;
+		Expect m_expect;
+		Token m_token;
+		bool m_escaped;
+		bool m_escapePending;
+		std::u8string m_pending;
+
+		const char8_t * Structural(const char8_t * ptr);
+		const char8_t * ScanString(const char8_t * ptr, const char8_t * end);
+		const char8_t * ScanScalar(const char8_t * ptr, const char8_t * end);
+
+		void Emit(std::u8string_view text);
+	};
+}
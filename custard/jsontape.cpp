@@ -0,0 +1,318 @@
+#include "jsontape.h"
+#include "jsontokenizer.h"
+#include "simd.h"
+
+#include <stdexcept>
+
+namespace custard
+{
+	template <typename CharT>
+	static bool IsLiteral(const CharT * ptr, const CharT * end, std::string_view literal) noexcept
+	{
+		if ((size_t) (end - ptr) != literal.size())
+		{
+			return false;
+		}
+
+		for (auto ch : literal)
+		{
+			if (*ptr++ != (CharT) ch)
+			{
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	template <typename CharT>
+	void JsonTape::Build(const CharT * begin, const CharT * end, size_t maxDepth)
+	{
+		enum class Expect { Value, ValueOrClose, Key, KeyOrClose, Colon, CommaOrClose, Done };
+
+		if ((uint64_t) (end - begin) > UINT32_MAX)
+		{
+			throw std::length_error("Text too long.");
+		}
+
+		std::vector<uint32_t> open;
+		Expect expect = Expect::Value;
+
+		m_entries.reserve((end - begin) / 8);
+
+		auto afterValue = [&]()
+		{
+			expect = open.empty() ? Expect::Done : Expect::CommaOrClose;
+		};
+
+		auto add = [&](Kind kind, const CharT * ptr, size_t length, bool escaped)
+		{
+			auto index = (uint32_t) m_entries.size();
+			m_entries.push_back({ kind, escaped, (uint32_t) (ptr - begin), (uint32_t) length, index + 1 });
+			return index;
+		};
+
+		for (auto ptr = simd::SkipWhiteSpace(begin, end); ptr < end; ptr = simd::SkipWhiteSpace(ptr, end))
+		{
+			const bool value = (expect == Expect::Value || expect == Expect::ValueOrClose);
+
+			switch (auto ch = *ptr)
+			{
+			case '{':
+			case '[':
+				if (!value)
+				{
+					break;
+				}
+
+				if (open.size() == maxDepth)
+				{
+					throw std::length_error("Too deeply nested.");
+				}
+
+				open.push_back(add((ch == '{') ? Kind::Object : Kind::Array, ptr++, 0, false));
+				expect = (ch == '{') ? Expect::KeyOrClose : Expect::ValueOrClose;
+				continue;
+
+			case '}':
+			case ']':
+				if (expect != Expect::CommaOrClose && expect != ((ch == '}') ? Expect::KeyOrClose : Expect::ValueOrClose))
+				{
+					break;
+				}
+
+				if (auto & entry = m_entries[open.back()]; entry.kind == ((ch == '}') ? Kind::Object : Kind::Array))
+				{
+					entry.length = (uint32_t) (++ptr - begin) - entry.offset;
+					entry.next = (uint32_t) m_entries.size();
+					open.pop_back();
+					afterValue();
+					continue;
+				}
+				break;
+
+			case ',':
+				if (expect != Expect::CommaOrClose)
+				{
+					break;
+				}
+
+				++ptr;
+				expect = (m_entries[open.back()].kind == Kind::Object) ? Expect::Key : Expect::Value;
+				continue;
+
+			case ':':
+				if (expect != Expect::Colon)
+				{
+					break;
+				}
+
+				++ptr;
+				expect = Expect::Value;
+				continue;
+
+			case '"':
+				if (value || expect == Expect::Key || expect == Expect::KeyOrClose)
+				{
+					bool escaped = false;
+					auto text = ++ptr;
+
+					while ((ptr = simd::FindQuoteOrEscape(ptr, end)) < end && *ptr == '\\')
+					{
+						if (++ptr == end || !IsEscapeChar(*ptr++))
+						{
+							throw std::invalid_argument("Invalid escape sequence.");
+						}
+
+						escaped = true;
+					}
+
+					if (ptr == end)
+					{
+						throw std::invalid_argument("Unterminated string.");
+					}
+
+					add(value ? Kind::String : Kind::Key, text, ptr++ - text, escaped);
+
+					if (value)
+					{
+						afterValue();
+					}
+					else
+					{
+						expect = Expect::Colon;
+					}
+
+					continue;
+				}
+				break;
+
+			default:
+				if (value)
+				{
+					auto text = ptr;
+					ptr = simd::FindDelimiter(ptr, end);
+
+					if (ch == '-' || (ch >= '0' && ch <= '9'))
+					{
+						add(Kind::Number, text, ptr - text, false);
+					}
+					else if (IsLiteral(text, ptr, "true") || IsLiteral(text, ptr, "false") || IsLiteral(text, ptr, "null"))
+					{
+						add(Kind::Literal, text, ptr - text, false);
+					}
+					else
+					{
+						break;
+					}
+
+					afterValue();
+					continue;
+				}
+				break;
+			}
+
+			throw std::invalid_argument("Unexpected character.");
+		}
+
+		if (expect != Expect::Done)
+		{
+			throw std::invalid_argument("Unexpected end of text.");
+		}
+	}
+
+
+	JsonTape::JsonTape(std::wstring_view text, size_t maxDepth) : m_source(text)
+	{
+		Build(text.data(), text.data() + text.size(), maxDepth);
+	}
+
+	JsonTape::JsonTape(std::u8string_view text, size_t maxDepth) : m_source(text)
+	{
+		Build(text.data(), text.data() + text.size(), maxDepth);
+	}
+
+	JsonTape::JsonTape(std::span<const std::byte> data, size_t maxDepth) : JsonTape(SkipByteOrderMark(data), maxDepth)
+	{}
+
+
+	const JsonTape::Entry & JsonTape::Node::Get() const
+	{
+		if (m_index >= m_end)
+		{
+			throw std::out_of_range("No such value.");
+		}
+
+		return m_tape->m_entries[m_index];
+	}
+
+	JsonTape::Node JsonTape::Node::First() const
+	{
+		auto & entry = Get();
+
+		if (entry.kind != Kind::Object && entry.kind != Kind::Array)
+		{
+			throw std::invalid_argument("Not an object or array.");
+		}
+
+		return Node(m_tape, m_index + 1, entry.next);
+	}
+
+	JsonTape::Node JsonTape::Node::Next() const
+	{
+		auto & entry = Get();
+
+		if (entry.kind == Kind::Key)
+		{
+			return Node(m_tape, m_tape->m_entries[m_index + 1].next, m_end);
+		}
+
+		return Node(m_tape, entry.next, m_end);
+	}
+
+	JsonTape::Node JsonTape::Node::Value() const
+	{
+		if (Get().kind != Kind::Key)
+		{
+			throw std::invalid_argument("Not a key.");
+		}
+
+		return Node(m_tape, m_index + 1, m_end);
+	}
+
+	JsonTape::Node JsonTape::Node::operator[](std::wstring_view key) const
+	{
+		if (Get().kind != Kind::Object)
+		{
+			throw std::invalid_argument("Not an object.");
+		}
+
+		auto node = First();
+
+		for (; node; node = node.Next())
+		{
+			if (node.GetString() == key)
+			{
+				return node.Value();
+			}
+		}
+
+		return node;
+	}
+
+	JsonTape::Node JsonTape::Node::operator[](size_t index) const
+	{
+		if (Get().kind != Kind::Array)
+		{
+			throw std::invalid_argument("Not an array.");
+		}
+
+		auto node = First();
+
+		for (; node && index > 0; --index)
+		{
+			node = node.Next();
+		}
+
+		return node;
+	}
+
+	JsonString JsonTape::Node::GetString() const
+	{
+		auto & entry = Get();
+
+		if (entry.kind == Kind::Object || entry.kind == Kind::Array)
+		{
+			throw std::invalid_argument("Not a string.");
+		}
+
+		return std::visit([&entry](auto text) { return JsonString(text.substr(entry.offset, entry.length), entry.escaped); }, m_tape->m_source);
+	}
+
+	JsonNumber JsonTape::Node::GetNumber() const
+	{
+		auto & entry = Get();
+
+		if (entry.kind == Kind::String)
+		{
+			return GetString().Number();
+		}
+
+		if (entry.kind != Kind::Number)
+		{
+			throw std::invalid_argument("Not a number.");
+		}
+
+		return std::visit([&entry](auto text) { return JsonNumber(text.substr(entry.offset, entry.length)); }, m_tape->m_source);
+	}
+
+	bool JsonTape::Node::GetBool() const
+	{
+		return Get().kind == Kind::Literal && GetString() == L"true";
+	}
+
+	bool JsonTape::Node::IsNull() const
+	{
+		return Get().kind == Kind::Literal && GetString() == L"null";
+	}
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include "json.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string_view>
+#include <variant>
+#include <vector>
+
+namespace custard
+{
+	//
+	// A whole document indexed in one pass, for callers that need to look at it more than once.
+	//
+	// Every value, and every key, becomes one entry of a flat tape that records where its text is in
+	// the source. Objects and arrays also record the entry just past their contents, so siblings are
+	// reached in constant time however large the values between them are. Like Json, the tape refers
+	// to the source text, which must outlive it.
+	//
+	class JsonTape
+	{
+	public:
+		enum class Kind : uint8_t { Object, Array, Key, String, Number, Literal };
+
+		struct Entry
+		{
+			Kind kind;
+			bool escaped;
+			uint32_t offset;
+			uint32_t length;
+			uint32_t next; // the entry after this one and its contents: the next sibling, or for a key its value
+		};
+
+		class Node
+		{
+			const JsonTape * m_tape;
+			uint32_t m_index;
+			uint32_t m_end; // end of the parent's contents
+
+		public:
+			Node(const JsonTape * tape, uint32_t index, uint32_t end) noexcept : m_tape(tape), m_index(index), m_end(end)
+			{}
+
+			// False for the nodes returned past the last child or for missing members.
+			explicit operator bool() const noexcept
+			{
+				return m_index < m_end;
+			}
+
+			Kind Type() const
+			{
+				return Get().kind;
+			}
+
+			// First child: the first key of an object or the first element of an array.
+			Node First() const;
+			Node Next() const;
+
+			// The value of a key.
+			Node Value() const;
+
+			Node operator[](std::wstring_view key) const;
+			Node operator[](size_t index) const;
+
+			JsonString GetString() const;
+			JsonNumber GetNumber() const;
+			bool GetBool() const;
+			bool IsNull() const;
+
+		private:
+			const Entry & Get() const;
+		};
+
+		JsonTape(std::wstring_view text, size_t maxDepth = JsonStack::DefaultMaxDepth);
+		JsonTape(std::u8string_view text, size_t maxDepth = JsonStack::DefaultMaxDepth);
+		JsonTape(std::span<const std::byte> data, size_t maxDepth = JsonStack::DefaultMaxDepth);
+
+		Node Root() const noexcept
+		{
+			return Node(this, 0, (uint32_t) m_entries.size());
+		}
+
+		size_t size() const noexcept
+		{
+			return m_entries.size();
+		}
+
+	private:
+		std::variant<std::wstring_view, std::u8string_view> m_source;
+		std::vector<Entry> m_entries;
+
+		template <typename CharT>
+		void Build(const CharT * begin, const CharT * end, size_t maxDepth);
+	};
+}
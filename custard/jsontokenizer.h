@@ -0,0 +1,306 @@
+#pragma once
+
+#include "json.h"
+#include "simd.h"
+
+#include <cstddef>
+#include <span>
+#include <stdexcept>
+#include <string_view>
+
+namespace custard
+{
+	inline wchar_t ValidateEscapeChar(wchar_t ch)
+	{
+		switch (ch)
+		{
+		case L'"':
+		case L'\\':
+		case L'/':
+			return ch;
+		case L'b':
+			return L'\b';
+		case L'f':
+			return L'\f';
+		case L'n':
+			return L'\n';
+		case L'r':
+			return L'\r';
+		case L't':
+			return L'\t';
+		case L'u':
+			return L'\0';
+		default:
+			throw std::invalid_argument("Invalid escape character.");
+		}
+	}
+
+	template <typename CharT>
+	constexpr bool IsEscapeChar(CharT ch) noexcept
+	{
+		switch (ch)
+		{
+		case '"':
+		case '\\':
+		case '/':
+		case 'b':
+		case 'f':
+		case 'n':
+		case 'r':
+		case 't':
+		case 'u':
+			return true;
+		default:
+			return false;
+		}
+	}
+
+	template <typename CharT>
+	constexpr bool IsHexDigit(CharT ch) noexcept
+	{
+		return (ch >= '0' && ch <= '9') || (ch >= 'a' && ch <= 'f') || (ch >= 'A' && ch <= 'F');
+	}
+
+	// The end of the longest prefix of [txt, end) that is a whole number in JSON's syntax.
+	template <typename CharT>
+	constexpr const CharT * NumberEnd(const CharT * txt, const CharT * end) noexcept
+	{
+		auto digits = [end](const CharT * ptr)
+		{
+			while (ptr < end && *ptr >= '0' && *ptr <= '9')
+			{
+				++ptr;
+			}
+
+			return ptr;
+		};
+
+		auto begin = txt;
+		const CharT * valid = nullptr;
+
+		if (txt < end && *txt == '-')
+		{
+			++txt;
+		}
+
+		if (txt < end && *txt == '0')
+		{
+			valid = ++txt;
+		}
+		else if ((valid = digits(txt)) == txt)
+		{
+			return begin;
+		}
+
+		txt = valid;
+
+		if (txt < end && *txt == '.')
+		{
+			if (auto fraction = digits(txt + 1); fraction > txt + 1)
+			{
+				valid = txt = fraction;
+			}
+			else
+			{
+				return valid;
+			}
+		}
+
+		if (txt < end && (*txt == 'e' || *txt == 'E'))
+		{
+			auto exponent = txt + 1;
+
+			if (exponent < end && (*exponent == '+' || *exponent == '-'))
+			{
+				++exponent;
+			}
+
+			if (auto last = digits(exponent); last > exponent)
+			{
+				valid = last;
+			}
+		}
+
+		return valid;
+	}
+
+	inline std::u8string_view SkipByteOrderMark(std::span<const std::byte> data)
+	{
+		std::u8string_view text((const char8_t *) data.data(), data.size());
+
+		if (text.starts_with(u8"\xEF\xBB\xBF"))
+		{
+			text.remove_prefix(3);
+		}
+
+		return text;
+	}
+
+	//
+	// Token scanning shared by the pull parser (Json) and the push parser (ParseJson), so that both
+	// accept exactly the same tokens. txt is advanced past each token it returns.
+	//
+	// A tokenizer that does not throw records the first malformed token in error instead, leaving txt
+	// where it was found; the caller must check error after each string or number it scans. It also
+	// checks what the throwing one leaves to decoding: the hex digits of \u escapes and number syntax.
+	//
+	template <typename CharT, bool Throwing = true>
+	struct JsonTokenizer
+	{
+		const CharT *& txt;
+		const CharT * const end;
+		JsonErrc error{};
+
+		JsonTokenizer(const CharT *& txt, const CharT * end) noexcept : txt(txt), end(end)
+		{}
+
+		void Fail(JsonErrc errc)
+		{
+			if constexpr (Throwing)
+			{
+				throw std::invalid_argument(make_error_code(errc).message());
+			}
+			else
+			{
+				error = errc;
+			}
+		}
+
+		bool SkipWhiteSpace() noexcept
+		{
+			txt = simd::SkipWhiteSpace(txt, end);
+			return txt < end;
+		}
+
+		bool SkipWhiteSpaceTo(CharT ch) noexcept
+		{
+			return SkipWhiteSpace() && *txt == ch;
+		}
+
+		// A key, which may also be unquoted.
+		JsonString ParseString()
+		{
+			if (*txt == '"')
+			{
+				++txt;
+				return QuotedString();
+			}
+
+			return UnquotedString();
+		}
+
+		// The rest of a string whose opening quote has been consumed.
+		JsonString QuotedString()
+		{
+			bool escape = false;
+			auto begin = txt;
+
+			while ((txt = simd::FindQuoteOrEscape(txt, end)) < end)
+			{
+				if (*txt == '"')
+				{
+					return JsonString({ begin, txt++ }, escape);
+				}
+
+				if (++txt < end)
+				{
+					if (!IsEscapeChar(*txt))
+					{
+						Fail(JsonErrc::InvalidEscape);
+						return JsonString({ begin, txt }, escape);
+					}
+
+					++txt;
+					escape = true;
+
+					if (!HexEscape())
+					{
+						Fail((txt < end) ? JsonErrc::InvalidEscape : JsonErrc::UnterminatedString);
+						return JsonString({ begin, txt }, escape);
+					}
+				}
+			}
+
+			Fail(JsonErrc::UnterminatedString);
+			return JsonString({ begin, txt }, escape);
+		}
+
+		JsonString UnquotedString()
+		{
+			bool escape = false;
+			auto begin = txt;
+
+			while ((txt = simd::FindDelimiter(txt, end)) < end)
+			{
+				if (*txt != '\\')
+				{
+					return JsonString({ begin, txt }, escape);
+				}
+
+				if (++txt < end)
+				{
+					if (!IsEscapeChar(*txt))
+					{
+						Fail(JsonErrc::InvalidEscape);
+						return JsonString({ begin, txt }, escape);
+					}
+
+					++txt;
+					escape = true;
+
+					if (!HexEscape())
+					{
+						Fail(JsonErrc::InvalidEscape);
+						return JsonString({ begin, txt }, escape);
+					}
+				}
+			}
+
+			return JsonString({ begin, end }, escape);
+		}
+
+		bool AtNumber() const noexcept
+		{
+			return *txt == '-' || (*txt >= '0' && *txt <= '9');
+		}
+
+		JsonNumber Number() noexcept
+		{
+			auto begin = txt;
+			txt = simd::FindDelimiter(txt, end);
+
+			if constexpr (!Throwing)
+			{
+				if (auto valid = NumberEnd(begin, txt); valid != txt)
+				{
+					error = JsonErrc::UnexpectedCharacter;
+					txt = valid;
+				}
+			}
+
+			return JsonNumber({ begin, txt });
+		}
+
+	private:
+		// Past the four hex digits after an escaped u, txt being just after the u, or at the first
+		// character that is not one. The throwing tokenizer leaves this to decoding.
+		bool HexEscape() noexcept
+		{
+			if constexpr (!Throwing)
+			{
+				if (txt[-1] == 'u')
+				{
+					for (int i = 0; i < 4; ++i, ++txt)
+					{
+						if (txt == end || !IsHexDigit(*txt))
+						{
+							return false;
+						}
+					}
+				}
+			}
+
+			return true;
+		}
+	};
+}
@@ -0,0 +1,195 @@
+#include "jsonwriter.h"
+#include "simd.h"
+#include "utf.h"
+
+#include <charconv>
+#include <cmath>
+#include <utility>
+
+namespace custard
+{
+	static void AppendRun(std::u8string & buffer, const char8_t * ptr, const char8_t * end)
+	{
+		buffer.append(ptr, end);
+	}
+
+	static void AppendRun(std::u8string & buffer, const wchar_t * ptr, const wchar_t * end)
+	{
+		auto size = buffer.size();
+
+		buffer.resize(size + MaxUtf8Length(end - ptr));
+		buffer.resize(ConvertTo(std::wstring_view(ptr, end), buffer.data() + size) - buffer.data());
+	}
+
+	static void AppendEscape(std::u8string & buffer, char32_t ch)
+	{
+		switch (ch)
+		{
+		case '"':
+			buffer.append(u8"\\\"");
+			break;
+		case '\\':
+			buffer.append(u8"\\\\");
+			break;
+		case '\b':
+			buffer.append(u8"\\b");
+			break;
+		case '\f':
+			buffer.append(u8"\\f");
+			break;
+		case '\n':
+			buffer.append(u8"\\n");
+			break;
+		case '\r':
+			buffer.append(u8"\\r");
+			break;
+		case '\t':
+			buffer.append(u8"\\t");
+			break;
+		default:
+			{
+				static constexpr char8_t hexChars[] = u8"0123456789ABCDEF";
+				char8_t units[] = { '\\', 'u', '0', '0', hexChars[(ch >> 4) & 0xF], hexChars[ch & 0xF] };
+				buffer.append(units, 6);
+			}
+			break;
+		}
+	}
+
+
+	void JsonWriter::Separator()
+	{
+		if (std::exchange(m_comma, true))
+		{
+			m_buffer.push_back(',');
+		}
+	}
+
+	template <typename CharT>
+	void JsonWriter::Quoted(std::basic_string_view<CharT> text)
+	{
+		auto ptr = text.data();
+		auto end = ptr + text.size();
+
+		m_buffer.push_back('"');
+
+		while (ptr < end)
+		{
+			auto next = simd::FindEscapeNeeded(ptr, end);
+
+			AppendRun(m_buffer, ptr, next);
+
+			if (next == end)
+			{
+				break;
+			}
+
+			AppendEscape(m_buffer, *next);
+			ptr = next + 1;
+		}
+
+		m_buffer.push_back('"');
+	}
+
+	JsonWriter & JsonWriter::BeginObject()
+	{
+		Separator();
+		m_buffer.push_back('{');
+		m_comma = false;
+		return *this;
+	}
+
+	JsonWriter & JsonWriter::EndObject()
+	{
+		m_buffer.push_back('}');
+		m_comma = true;
+		return *this;
+	}
+
+	JsonWriter & JsonWriter::BeginArray()
+	{
+		Separator();
+		m_buffer.push_back('[');
+		m_comma = false;
+		return *this;
+	}
+
+	JsonWriter & JsonWriter::EndArray()
+	{
+		m_buffer.push_back(']');
+		m_comma = true;
+		return *this;
+	}
+
+	JsonWriter & JsonWriter::Key(std::wstring_view name)
+	{
+		Separator();
+		Quoted(name);
+		m_buffer.push_back(':');
+		m_comma = false;
+		return *this;
+	}
+
+	JsonWriter & JsonWriter::Key(std::u8string_view name)
+	{
+		Separator();
+		Quoted(name);
+		m_buffer.push_back(':');
+		m_comma = false;
+		return *this;
+	}
+
+	JsonWriter & JsonWriter::String(std::wstring_view value)
+	{
+		Separator();
+		Quoted(value);
+		return *this;
+	}
+
+	JsonWriter & JsonWriter::String(std::u8string_view value)
+	{
+		Separator();
+		Quoted(value);
+		return *this;
+	}
+
+	JsonWriter & JsonWriter::Number(int64_t value)
+	{
+		char text[24];
+		auto result = std::to_chars(text, text + sizeof(text), value);
+
+		Separator();
+		m_buffer.append((const char8_t *) text, (const char8_t *) result.ptr);
+		return *this;
+	}
+
+	JsonWriter & JsonWriter::Number(double value)
+	{
+		// JSON has no representation for infinities and NaN.
+		if (!std::isfinite(value))
+		{
+			return Null();
+		}
+
+		char text[32];
+		auto result = std::to_chars(text, text + sizeof(text), value);
+
+		Separator();
+		m_buffer.append((const char8_t *) text, (const char8_t *) result.ptr);
+		return *this;
+	}
+
+	JsonWriter & JsonWriter::Bool(bool value)
+	{
+		Separator();
+		m_buffer.append(value ? u8"true" : u8"false");
+		return *this;
+	}
+
+	JsonWriter & JsonWriter::Null()
+	{
+		Separator();
+		m_buffer.append(u8"null");
+		return *this;
+	}
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+
+namespace custard
+{
+	//
+	// Writes compact JSON as UTF-8 straight into a buffer that grows as needed and keeps its capacity
+	// across Clear(), so one writer can serve every request. Commas are inserted automatically; the
+	// caller is trusted to balance Begin and End.
+	//
+	class JsonWriter
+	{
+		std::u8string m_buffer;
+		bool m_comma;
+
+	public:
+		JsonWriter() noexcept : m_comma(false)
+		{}
+
+		JsonWriter & BeginObject();
+		JsonWriter & EndObject();
+		JsonWriter & BeginArray();
+		JsonWriter & EndArray();
+
+		JsonWriter & Key(std::wstring_view name);
+		JsonWriter & Key(std::u8string_view name);
+
+		JsonWriter & String(std::wstring_view value);
+		JsonWriter & String(std::u8string_view value);
+
+		JsonWriter & Number(int64_t value);
+		JsonWriter & Number(double value);
+		JsonWriter & Bool(bool value);
+		JsonWriter & Null();
+
+		void Clear() noexcept
+		{
+			m_buffer.clear();
+			m_comma = false;
+		}
+
+		std::u8string_view View() const noexcept
+		{
+			return m_buffer;
+		}
+
+		std::span<const std::byte> Bytes() const noexcept
+		{
+			return { (const std::byte *) m_buffer.data(), m_buffer.size() };
+		}
+
+	private:
+		void Separator();
+
+		template <typename CharT>
+		void Quoted(std::basic_string_view<CharT> text);
+	};
+}
@@ -0,0 +1,67 @@
+#include "mappedfile.h"
+
+#include <system_error>
+
+namespace custard
+{
+	MappedFile::MappedFile(const std::filesystem::path & path) : m_file(INVALID_HANDLE_VALUE), m_mapping(nullptr), m_data(nullptr), m_size(0)
+	{
+		m_file = ::CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+
+		if (m_file == INVALID_HANDLE_VALUE)
+		{
+			throw std::system_error(::GetLastError(), std::system_category(), "CreateFileW");
+		}
+
+		LARGE_INTEGER size{};
+
+		if (!::GetFileSizeEx(m_file, &size))
+		{
+			auto error = ::GetLastError();
+			::CloseHandle(m_file);
+			throw std::system_error(error, std::system_category(), "GetFileSizeEx");
+		}
+
+		// An empty file cannot be mapped, and needs no mapping anyway.
+		if (size.QuadPart == 0)
+		{
+			return;
+		}
+
+		m_mapping = ::CreateFileMappingW(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+
+		if (m_mapping == nullptr)
+		{
+			auto error = ::GetLastError();
+			::CloseHandle(m_file);
+			throw std::system_error(error, std::system_category(), "CreateFileMappingW");
+		}
+
+		m_data = (const std::byte *) ::MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0);
+
+		if (m_data == nullptr)
+		{
+			auto error = ::GetLastError();
+			::CloseHandle(m_mapping);
+			::CloseHandle(m_file);
+			throw std::system_error(error, std::system_category(), "MapViewOfFile");
+		}
+
+		m_size = (size_t) size.QuadPart;
+	}
+
+	MappedFile::~MappedFile() noexcept
+	{
+		if (m_data)
+		{
+			::UnmapViewOfFile(m_data);
+		}
+
+		if (m_mapping)
+		{
+			::CloseHandle(m_mapping);
+		}
+
+		::CloseHandle(m_file);
+	}
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <Windows.h>
+
+#include <cstddef>
+#include <filesystem>
+#include <span>
+
+namespace custard
+{
+	//
+	// A whole file mapped read-only into memory, for parsing archives without reading them first.
+	//
+	class MappedFile
+	{
+		HANDLE m_file;
+		HANDLE m_mapping;
+		const std::byte * m_data;
+		size_t m_size;
+
+	public:
+		MappedFile(const std::filesystem::path & path);
+		~MappedFile() noexcept;
+
+		MappedFile(const MappedFile &) = delete;
+		MappedFile & operator=(const MappedFile &) = delete;
+
+		std::span<const std::byte> Bytes() const noexcept
+		{
+			return { m_data, m_size };
+		}
+	};
+}
@@ -0,0 +1,129 @@
+#include "rangeddownload.h"
+#include "httpcache.h"
+#include "jsontape.h"
+#include "jsonwriter.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+
+namespace custard
+{
+	RangedDownload::RangedDownload(std::filesystem::path sidecar, std::wstring_view url, std::wstring_view validator, uint64_t length, size_t count) :
+		m_sidecar(std::move(sidecar)), m_url(url), m_validator(validator), m_length(length)
+	{
+		if (Load())
+		{
+			m_resumed = true;
+			return;
+		}
+
+		count = (size_t) std::clamp<uint64_t>((length + MinRangeSize - 1) / MinRangeSize, 1, std::max<size_t>(count, 1));
+
+		for (size_t i = 0; i < count; ++i)
+		{
+			m_ranges.push_back({ length * i / count, length * (i + 1) / count, 0 });
+		}
+	}
+
+	// A sidecar that cannot be read, or is for another file, is ignored. So is any sidecar when there is
+	// no validator, since a changed file of the same length could not be told from the old one.
+	bool RangedDownload::Load()
+	{
+		if (m_validator.empty())
+		{
+			return false;
+		}
+
+		std::ifstream file(m_sidecar, std::ios::binary);
+
+		if (!file)
+		{
+			return false;
+		}
+
+		std::string text{ std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>() };
+
+		try
+		{
+			JsonTape tape(std::u8string_view((const char8_t *) text.data(), text.size()));
+			auto root = tape.Root();
+
+			if (root[L"url"].GetString() != m_url || root[L"validator"].GetString() != m_validator || (uint64_t) root[L"length"].GetNumber().Int64() != m_length)
+			{
+				return false;
+			}
+
+			std::vector<ByteRange> ranges;
+
+			for (auto node = root[L"ranges"].First(); node; node = node.Next())
+			{
+				ByteRange range{ (uint64_t) node[0].GetNumber().Int64(), (uint64_t) node[1].GetNumber().Int64(), (uint64_t) node[2].GetNumber().Int64() };
+
+				if (range.begin > range.end || range.end > m_length || range.done > range.end - range.begin)
+				{
+					return false;
+				}
+
+				ranges.push_back(range);
+			}
+
+			m_ranges = std::move(ranges);
+			return !m_ranges.empty();
+		}
+		catch (const std::exception &)
+		{
+			return false;
+		}
+	}
+
+	std::vector<ByteRange> RangedDownload::Ranges() const
+	{
+		std::lock_guard lock(m_mutex);
+		return m_ranges;
+	}
+
+	void RangedDownload::Advance(size_t index, uint64_t bytes)
+	{
+		std::lock_guard lock(m_mutex);
+
+		m_ranges.at(index).done += bytes;
+
+		if ((m_unsaved += bytes) >= SaveInterval)
+		{
+			SaveLocked();
+		}
+	}
+
+	void RangedDownload::Save()
+	{
+		std::lock_guard lock(m_mutex);
+		SaveLocked();
+	}
+
+	void RangedDownload::SaveLocked()
+	{
+		JsonWriter writer;
+		writer.BeginObject()
+			.Key(L"url").String(m_url)
+			.Key(L"validator").String(m_validator)
+			.Key(L"length").Number((int64_t) m_length)
+			.Key(L"ranges").BeginArray();
+
+		for (auto & range : m_ranges)
+		{
+			writer.BeginArray().Number((int64_t) range.begin).Number((int64_t) range.end).Number((int64_t) range.done).EndArray();
+		}
+
+		writer.EndArray().EndObject();
+
+		WriteWholeFile(m_sidecar, writer.Bytes());
+		m_unsaved = 0;
+	}
+
+	void RangedDownload::Remove() noexcept
+	{
+		std::error_code ec;
+		std::filesystem::remove(m_sidecar, ec);
+	}
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace custard
+{
+	struct ByteRange
+	{
+		uint64_t begin; // the first byte
+		uint64_t end;   // one past the last byte
+		uint64_t done;  // bytes from begin already written
+
+		uint64_t Next() const noexcept
+		{
+			return begin + done;
+		}
+
+		bool Complete() const noexcept
+		{
+			return begin + done >= end;
+		}
+	};
+
+	//
+	// The progress of a download split into byte ranges, kept in a sidecar file next to the partial file
+	// so that an interrupted download resumes where each range stopped.
+	//
+	// A sidecar is only resumed for the same URL, length and validator (the ETag or Last-Modified of the
+	// file), and never without a validator; otherwise the download starts over. Progress is recorded after the bytes are written, and
+	// saved every SaveInterval bytes and by Save(), so the sidecar never claims more than the file holds.
+	//
+	class RangedDownload
+	{
+		std::filesystem::path m_sidecar;
+		std::wstring m_url;
+		std::wstring m_validator;
+		uint64_t m_length;
+		std::vector<ByteRange> m_ranges;
+		bool m_resumed = false;
+		uint64_t m_unsaved = 0;
+		mutable std::mutex m_mutex;
+
+	public:
+		static constexpr uint64_t MinRangeSize = 1024 * 1024;
+		static constexpr uint64_t SaveInterval = 8 * 1024 * 1024;
+
+		RangedDownload(std::filesystem::path sidecar, std::wstring_view url, std::wstring_view validator, uint64_t length, size_t count);
+		~RangedDownload() noexcept = default;
+
+		RangedDownload(const RangedDownload &) = delete;
+		RangedDownload & operator=(const RangedDownload &) = delete;
+
+		bool Resumed() const noexcept
+		{
+			return m_resumed;
+		}
+
+		std::vector<ByteRange> Ranges() const;
+
+		// Records that bytes more of range index are written. Safe to call from any thread.
+		void Advance(size_t index, uint64_t bytes);
+
+		void Save();
+		void Remove() noexcept;
+
+	private:
+		bool Load();
+		void SaveLocked();
+	};
+}
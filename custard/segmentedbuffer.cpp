@@ -0,0 +1,116 @@
+#include "segmentedbuffer.h"
+
+#include <cstring>
+
+namespace custard
+{
+	void ChunkPool::Return::operator()(std::byte * block) const noexcept
+	{
+		Instance().Release(block);
+	}
+
+	ChunkPool::ChunkPool()
+	{
+		m_free.reserve(MaxFree);
+	}
+
+	ChunkPool & ChunkPool::Instance()
+	{
+		static ChunkPool pool;
+		return pool;
+	}
+
+	ChunkPool::Chunk ChunkPool::Acquire()
+	{
+		{
+			std::lock_guard lock(m_mutex);
+
+			if (!m_free.empty())
+			{
+				auto block = m_free.back().release();
+				m_free.pop_back();
+				return Chunk(block);
+			}
+		}
+
+		return Chunk(std::make_unique_for_overwrite<std::byte[]>(ChunkSize).release());
+	}
+
+	void ChunkPool::Release(std::byte * block) noexcept
+	{
+		std::unique_ptr<std::byte[]> owned(block);
+		std::lock_guard lock(m_mutex);
+
+		// The free list has room reserved for MaxFree blocks, so this does not allocate.
+		if (m_free.size() < MaxFree)
+		{
+			m_free.push_back(std::move(owned));
+		}
+	}
+
+
+	std::span<std::byte> SegmentedBuffer::Prepare()
+	{
+		if (m_size == m_chunks.size() * ChunkPool::ChunkSize)
+		{
+			m_chunks.push_back(ChunkPool::Instance().Acquire());
+		}
+
+		auto offset = m_size % ChunkPool::ChunkSize;
+		return { m_chunks[m_size / ChunkPool::ChunkSize].get() + offset, ChunkPool::ChunkSize - offset };
+	}
+
+	void SegmentedBuffer::Commit(size_t size) noexcept
+	{
+		m_size += size;
+		m_joined.clear();
+	}
+
+	void SegmentedBuffer::Append(std::span<const std::byte> data)
+	{
+		while (!data.empty())
+		{
+			auto space = Prepare();
+			auto count = std::min(space.size(), data.size());
+
+			std::memcpy(space.data(), data.data(), count);
+			Commit(count);
+			data = data.subspan(count);
+		}
+	}
+
+	void SegmentedBuffer::Clear() noexcept
+	{
+		m_chunks.clear();
+		m_joined.clear();
+		m_size = 0;
+	}
+
+	std::span<const std::byte> SegmentedBuffer::Contiguous()
+	{
+		if (m_size <= ChunkPool::ChunkSize)
+		{
+			return { m_chunks.empty() ? nullptr : m_chunks.front().get(), m_size };
+		}
+
+		if (m_joined.empty())
+		{
+			m_joined = ToVector();
+		}
+
+		return m_joined;
+	}
+
+	std::vector<std::byte> SegmentedBuffer::ToVector() const
+	{
+		std::vector<std::byte> data;
+		data.reserve(m_size);
+
+		for (auto chunk : *this)
+		{
+			data.insert(data.end(), chunk.begin(), chunk.end());
+		}
+
+		return data;
+	}
+}
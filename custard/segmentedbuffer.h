@@ -0,0 +1,136 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <vector>
+
+namespace custard
+{
+	//
+	// Fixed-size blocks of memory shared by every SegmentedBuffer in the process, so that reading a body
+	// reuses the blocks of earlier ones instead of allocating. At most MaxFree blocks are kept.
+	//
+	class ChunkPool
+	{
+	public:
+		static constexpr size_t ChunkSize = 16 * 1024;
+		static constexpr size_t MaxFree = 64;
+
+		// Hands the block back to the pool when the chunk goes.
+		struct Return
+		{
+			void operator()(std::byte * block) const noexcept;
+		};
+
+		using Chunk = std::unique_ptr<std::byte[], Return>;
+
+		static ChunkPool & Instance();
+
+		Chunk Acquire();
+
+	private:
+		std::mutex m_mutex;
+		std::vector<std::unique_ptr<std::byte[]>> m_free;
+
+		ChunkPool();
+
+		void Release(std::byte * block) noexcept;
+	};
+
+	//
+	// A body read into a list of pooled chunks, so that it grows without reallocating or copying what it
+	// already holds. Iterating yields the filled part of each chunk in order, for consumers that take
+	// the content piece by piece; Contiguous() joins the chunks only when one asks for a single span.
+	//
+	class SegmentedBuffer
+	{
+		std::vector<ChunkPool::Chunk> m_chunks;
+		size_t m_size = 0;
+		std::vector<std::byte> m_joined;
+
+	public:
+		class Iterator
+		{
+			const SegmentedBuffer * m_buffer = nullptr;
+			size_t m_index = 0;
+
+		public:
+			using iterator_category = std::forward_iterator_tag;
+			using value_type = std::span<const std::byte>;
+			using difference_type = std::ptrdiff_t;
+			using pointer = void;
+			using reference = value_type;
+
+			Iterator() noexcept = default;
+
+			Iterator(const SegmentedBuffer * buffer, size_t index) noexcept : m_buffer(buffer), m_index(index)
+			{}
+
+			value_type operator*() const noexcept
+			{
+				auto offset = m_index * ChunkPool::ChunkSize;
+				return { m_buffer->m_chunks[m_index].get(), std::min(ChunkPool::ChunkSize, m_buffer->m_size - offset) };
+			}
+
+			Iterator & operator++() noexcept
+			{
+				++m_index;
+				return *this;
+			}
+
+			Iterator operator++(int) noexcept
+			{
+				auto copy = *this;
+				++m_index;
+				return copy;
+			}
+
+			bool operator==(const Iterator & other) const noexcept = default;
+		};
+
+		SegmentedBuffer() noexcept = default;
+		~SegmentedBuffer() noexcept = default;
+
+		SegmentedBuffer(SegmentedBuffer &&) noexcept = default;
+		SegmentedBuffer & operator=(SegmentedBuffer &&) noexcept = default;
+
+		// Writable space after the content; a fresh chunk when the last one is full.
+		std::span<std::byte> Prepare();
+
+		// Adds size bytes written into the space Prepare() returned.
+		void Commit(size_t size) noexcept;
+
+		void Append(std::span<const std::byte> data);
+
+		void Clear() noexcept;
+
+		size_t size() const noexcept
+		{
+			return m_size;
+		}
+
+		bool empty() const noexcept
+		{
+			return m_size == 0;
+		}
+
+		Iterator begin() const noexcept
+		{
+			return { this, 0 };
+		}
+
+		Iterator end() const noexcept
+		{
+			return { this, (m_size + ChunkPool::ChunkSize - 1) / ChunkPool::ChunkSize };
+		}
+
+		// The whole content as one span: the first chunk itself when it holds all of it, else a copy made once.
+		std::span<const std::byte> Contiguous();
+
+		std::vector<std::byte> ToVector() const;
+	};
+}
@@ -0,0 +1,584 @@
+#include "simd.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define CUSTARD_SIMD_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+namespace custard::simd
+{
+	enum class Match { QuoteOrEscape, Delimiter, NotWhiteSpace, EscapeNeeded, NonAscii };
+
+	template <typename CharT>
+	constexpr bool IsWhiteSpace(CharT ch) noexcept
+	{
+		return (std::make_unsigned_t<CharT>) ch <= 0x20;
+	}
+
+	template <Match M, typename CharT>
+	constexpr bool IsMatch(CharT ch) noexcept
+	{
+		if constexpr (M == Match::QuoteOrEscape)
+		{
+			return ch == '"' || ch == '\\';
+		}
+		else if constexpr (M == Match::Delimiter)
+		{
+			switch (ch)
+			{
+			case ',':
+			case '[':
+			case ']':
+			case '{':
+			case '}':
+			case '\\':
+				return true;
+			default:
+				return IsWhiteSpace(ch);
+			}
+		}
+		else if constexpr (M == Match::NotWhiteSpace)
+		{
+			return !IsWhiteSpace(ch);
+		}
+		else if constexpr (M == Match::EscapeNeeded)
+		{
+			return ch == '"' || ch == '\\' || (std::make_unsigned_t<CharT>) ch < 0x20;
+		}
+		else
+		{
+			return (std::make_unsigned_t<CharT>) ch >= 0x80;
+		}
+	}
+
+	template <Match M, typename CharT>
+	const CharT * FindScalar(const CharT * ptr, const CharT * end) noexcept
+	{
+		while (ptr < end && !IsMatch<M>(*ptr))
+		{
+			++ptr;
+		}
+
+		return ptr;
+	}
+
+	template <typename CharT, typename OtherT>
+	const CharT * CopyAsciiScalar(const CharT * ptr, const CharT * end, OtherT * out) noexcept
+	{
+		while (ptr < end && !IsMatch<Match::NonAscii>(*ptr))
+		{
+			*out++ = (OtherT) *ptr++;
+		}
+
+		return ptr;
+	}
+
+	template <typename CharT>
+	const CharT * SkipNestedScalar(const CharT * ptr, const CharT * end, size_t depth) noexcept
+	{
+		bool inString = false;
+
+		while (ptr < end)
+		{
+			auto ch = *ptr++;
+
+			if (ch == '\\')
+			{
+				// Only quotes and backslashes lose their meaning, as in the block scanner.
+				if (ptr < end && (*ptr == '"' || *ptr == '\\'))
+				{
+					++ptr;
+				}
+			}
+			else if (ch == '"')
+			{
+				inString = !inString;
+			}
+			else if (inString)
+			{
+				continue;
+			}
+			else if (ch == '{' || ch == '[')
+			{
+				++depth;
+			}
+			else if ((ch == '}' || ch == ']') && --depth == 0)
+			{
+				return ptr;
+			}
+		}
+
+		return nullptr;
+	}
+
+	// Movemask results carry one bit per byte; keep one bit per N-byte code unit.
+	template <size_t N>
+	constexpr uint32_t Compress(uint32_t mask) noexcept
+	{
+		if constexpr (N == 2)
+		{
+			mask &= 0x55555555;
+			mask = (mask | (mask >> 1)) & 0x33333333;
+			mask = (mask | (mask >> 2)) & 0x0F0F0F0F;
+			mask = (mask | (mask >> 4)) & 0x00FF00FF;
+			mask = (mask | (mask >> 8)) & 0x0000FFFF;
+		}
+		else if constexpr (N == 4)
+		{
+			mask &= 0x11111111;
+			mask = (mask | (mask >> 3)) & 0x03030303;
+			mask = (mask | (mask >> 6)) & 0x000F000F;
+			mask = (mask | (mask >> 12)) & 0x000000FF;
+		}
+
+		return mask;
+	}
+
+	// Bitmaps of one 64 code unit block, bit i for code unit i.
+	struct Structurals
+	{
+		uint64_t quote;
+		uint64_t backslash;
+		uint64_t open;
+		uint64_t close;
+	};
+
+	//
+	// Tracks escapes, strings and depth across blocks. The escape handling follows simdjson: a
+	// character is escaped if it follows an odd-length run of backslashes.
+	//
+	struct NestingScanner
+	{
+		size_t depth;
+		uint64_t escapedCarry;
+		uint64_t inString;
+
+		NestingScanner(size_t depth) noexcept : depth(depth), escapedCarry(0), inString(0)
+		{}
+
+		uint64_t Escaped(uint64_t backslash) noexcept
+		{
+			constexpr uint64_t even = 0x5555555555555555;
+
+			backslash &= ~escapedCarry;
+
+			auto followsEscape = (backslash << 1) | escapedCarry;
+			auto oddStarts = backslash & ~even & ~followsEscape;
+			auto evenStarts = oddStarts + backslash;
+
+			escapedCarry = (evenStarts < oddStarts) ? 1 : 0;
+
+			return (even ^ (evenStarts << 1)) & followsEscape;
+		}
+
+		static uint64_t PrefixXor(uint64_t bits) noexcept
+		{
+			bits ^= bits << 1;
+			bits ^= bits << 2;
+			bits ^= bits << 4;
+			bits ^= bits << 8;
+			bits ^= bits << 16;
+			bits ^= bits << 32;
+			return bits;
+		}
+
+		// The position of the bracket that closes the outermost level, or 64.
+		size_t Next(const Structurals & block) noexcept
+		{
+			auto quotes = block.quote & ~Escaped(block.backslash);
+			auto strings = PrefixXor(quotes) ^ inString;
+
+			inString = (uint64_t) ((int64_t) strings >> 63);
+
+			auto open = block.open & ~strings;
+			auto close = block.close & ~strings;
+
+			for (auto bits = open | close; bits; bits &= bits - 1)
+			{
+				auto pos = std::countr_zero(bits);
+
+				if ((open >> pos) & 1)
+				{
+					++depth;
+				}
+				else if (--depth == 0)
+				{
+					return pos;
+				}
+			}
+
+			return 64;
+		}
+	};
+
+	template <typename CharT>
+	using Finder = const CharT * (*)(const CharT *, const CharT *) noexcept;
+
+	template <typename CharT>
+	using NestedFinder = const CharT * (*)(const CharT *, const CharT *, size_t) noexcept;
+
+	// UTF-8 and wide strings convert into each other.
+	template <typename CharT>
+	using OtherChar = std::conditional_t<sizeof(CharT) == 1, wchar_t, char8_t>;
+
+	template <typename CharT>
+	using AsciiCopier = const CharT * (*)(const CharT *, const CharT *, OtherChar<CharT> *) noexcept;
+
+	template <typename CharT>
+	struct Finders
+	{
+		Finder<CharT> quoteOrEscape;
+		Finder<CharT> delimiter;
+		Finder<CharT> notWhiteSpace;
+		NestedFinder<CharT> skipNested;
+		Finder<CharT> escapeNeeded;
+		AsciiCopier<CharT> copyAscii;
+	};
+
+	namespace scalar
+	{
+		template <typename CharT>
+		constexpr Finders<CharT> Select() noexcept
+		{
+			return { FindScalar<Match::QuoteOrEscape, CharT>, FindScalar<Match::Delimiter, CharT>, FindScalar<Match::NotWhiteSpace, CharT>, SkipNestedScalar<CharT>, FindScalar<Match::EscapeNeeded, CharT>, CopyAsciiScalar<CharT, OtherChar<CharT>> };
+		}
+	}
+
+#if defined(CUSTARD_SIMD_X86)
+
+#if defined(__clang__)
+#pragma clang attribute push(__attribute__((target("sse2"))), apply_to = function)
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC target("sse2")
+#endif
+
+	namespace sse2
+	{
+		template <size_t N>
+		struct Lanes
+		{
+			using Vector = __m128i;
+
+			static constexpr size_t Count = sizeof(Vector) / N;
+			static constexpr uint32_t All = 0xFFFF;
+
+			static Vector Load(const void * ptr) noexcept
+			{
+				return _mm_loadu_si128((const __m128i *) ptr);
+			}
+
+			static Vector Splat(int ch) noexcept
+			{
+				if constexpr (N == 1)
+				{
+					return _mm_set1_epi8((char) ch);
+				}
+				else if constexpr (N == 2)
+				{
+					return _mm_set1_epi16((short) ch);
+				}
+				else
+				{
+					return _mm_set1_epi32(ch);
+				}
+			}
+
+			static Vector Equal(Vector a, Vector b) noexcept
+			{
+				if constexpr (N == 1)
+				{
+					return _mm_cmpeq_epi8(a, b);
+				}
+				else if constexpr (N == 2)
+				{
+					return _mm_cmpeq_epi16(a, b);
+				}
+				else
+				{
+					return _mm_cmpeq_epi32(a, b);
+				}
+			}
+
+			static Vector Or(Vector a, Vector b) noexcept
+			{
+				return _mm_or_si128(a, b);
+			}
+
+			static Vector WhiteSpace(Vector v) noexcept
+			{
+				if constexpr (N == 1)
+				{
+					return _mm_cmpeq_epi8(_mm_subs_epu8(v, Splat(0x20)), _mm_setzero_si128());
+				}
+				else if constexpr (N == 2)
+				{
+					return _mm_cmpeq_epi16(_mm_subs_epu16(v, Splat(0x20)), _mm_setzero_si128());
+				}
+				else
+				{
+					return _mm_and_si128(_mm_cmpgt_epi32(v, Splat(-1)), _mm_cmplt_epi32(v, Splat(0x21)));
+				}
+			}
+
+			static Vector Ascii(Vector v) noexcept
+			{
+				if constexpr (N == 1)
+				{
+					return _mm_cmpgt_epi8(v, Splat(-1));
+				}
+				else if constexpr (N == 2)
+				{
+					return _mm_cmpeq_epi16(_mm_subs_epu16(v, Splat(0x7F)), _mm_setzero_si128());
+				}
+				else
+				{
+					return _mm_and_si128(_mm_cmpgt_epi32(v, Splat(-1)), _mm_cmplt_epi32(v, Splat(0x80)));
+				}
+			}
+
+			static uint32_t MoveMask(Vector v) noexcept
+			{
+				return (uint32_t) _mm_movemask_epi8(v);
+			}
+		};
+
+#include "simd.inl"
+
+		template <typename CharT>
+		Finders<CharT> Select() noexcept
+		{
+			return { Find<Match::QuoteOrEscape, CharT>, Find<Match::Delimiter, CharT>, Find<Match::NotWhiteSpace, CharT>, SkipNested<CharT>, Find<Match::EscapeNeeded, CharT>, CopyAscii<CharT, OtherChar<CharT>> };
+		}
+	}
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#pragma clang attribute push(__attribute__((target("avx2"))), apply_to = function)
+#elif defined(__GNUC__)
+#pragma GCC pop_options
+#pragma GCC push_options
+#pragma GCC target("avx2")
+#endif
+
+	namespace avx2
+	{
+		template <size_t N>
+		struct Lanes
+		{
+			using Vector = __m256i;
+
+			static constexpr size_t Count = sizeof(Vector) / N;
+			static constexpr uint32_t All = 0xFFFFFFFF;
+
+			static Vector Load(const void * ptr) noexcept
+			{
+				return _mm256_loadu_si256((const __m256i *) ptr);
+			}
+
+			static Vector Splat(int ch) noexcept
+			{
+				if constexpr (N == 1)
+				{
+					return _mm256_set1_epi8((char) ch);
+				}
+				else if constexpr (N == 2)
+				{
+					return _mm256_set1_epi16((short) ch);
+				}
+				else
+				{
+					return _mm256_set1_epi32(ch);
+				}
+			}
+
+			static Vector Equal(Vector a, Vector b) noexcept
+			{
+				if constexpr (N == 1)
+				{
+					return _mm256_cmpeq_epi8(a, b);
+				}
+				else if constexpr (N == 2)
+				{
+					return _mm256_cmpeq_epi16(a, b);
+				}
+				else
+				{
+					return _mm256_cmpeq_epi32(a, b);
+				}
+			}
+
+			static Vector Or(Vector a, Vector b) noexcept
+			{
+				return _mm256_or_si256(a, b);
+			}
+
+			static Vector WhiteSpace(Vector v) noexcept
+			{
+				if constexpr (N == 1)
+				{
+					return _mm256_cmpeq_epi8(_mm256_subs_epu8(v, Splat(0x20)), _mm256_setzero_si256());
+				}
+				else if constexpr (N == 2)
+				{
+					return _mm256_cmpeq_epi16(_mm256_subs_epu16(v, Splat(0x20)), _mm256_setzero_si256());
+				}
+				else
+				{
+					return _mm256_and_si256(_mm256_cmpgt_epi32(v, Splat(-1)), _mm256_cmpgt_epi32(Splat(0x21), v));
+				}
+			}
+
+			static Vector Ascii(Vector v) noexcept
+			{
+				if constexpr (N == 1)
+				{
+					return _mm256_cmpgt_epi8(v, Splat(-1));
+				}
+				else if constexpr (N == 2)
+				{
+					return _mm256_cmpeq_epi16(_mm256_subs_epu16(v, Splat(0x7F)), _mm256_setzero_si256());
+				}
+				else
+				{
+					return _mm256_and_si256(_mm256_cmpgt_epi32(v, Splat(-1)), _mm256_cmpgt_epi32(Splat(0x80), v));
+				}
+			}
+
+			static uint32_t MoveMask(Vector v) noexcept
+			{
+				return (uint32_t) _mm256_movemask_epi8(v);
+			}
+		};
+
+#include "simd.inl"
+
+		template <typename CharT>
+		Finders<CharT> Select() noexcept
+		{
+			return { Find<Match::QuoteOrEscape, CharT>, Find<Match::Delimiter, CharT>, Find<Match::NotWhiteSpace, CharT>, SkipNested<CharT>, Find<Match::EscapeNeeded, CharT>, CopyAscii<CharT, OtherChar<CharT>> };
+		}
+	}
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#elif defined(__GNUC__)
+#pragma GCC pop_options
+#endif
+
+	static bool HasAvx2() noexcept
+	{
+#if defined(_MSC_VER)
+		int info[4]{};
+
+		__cpuid(info, 0);
+
+		if (info[0] < 7)
+		{
+			return false;
+		}
+
+		__cpuid(info, 1);
+
+		// OSXSAVE and AVX, then the OS must preserve the YMM state.
+		if ((info[2] & (1 << 27)) == 0 || (info[2] & (1 << 28)) == 0 || (_xgetbv(0) & 6) != 6)
+		{
+			return false;
+		}
+
+		__cpuidex(info, 7, 0);
+
+		return (info[1] & (1 << 5)) != 0;
+#else
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("avx2");
+#endif
+	}
+
+	template <typename CharT>
+	static const Finders<CharT> & Select() noexcept
+	{
+		static const Finders<CharT> finders = HasAvx2() ? avx2::Select<CharT>() : sse2::Select<CharT>();
+		return finders;
+	}
+
+#else
+
+	template <typename CharT>
+	static const Finders<CharT> & Select() noexcept
+	{
+		static constexpr Finders<CharT> finders = scalar::Select<CharT>();
+		return finders;
+	}
+
+#endif
+
+	const wchar_t * FindQuoteOrEscape(const wchar_t * ptr, const wchar_t * end) noexcept
+	{
+		return Select<wchar_t>().quoteOrEscape(ptr, end);
+	}
+
+	const char8_t * FindQuoteOrEscape(const char8_t * ptr, const char8_t * end) noexcept
+	{
+		return Select<char8_t>().quoteOrEscape(ptr, end);
+	}
+
+	const wchar_t * FindDelimiter(const wchar_t * ptr, const wchar_t * end) noexcept
+	{
+		return Select<wchar_t>().delimiter(ptr, end);
+	}
+
+	const char8_t * FindDelimiter(const char8_t * ptr, const char8_t * end) noexcept
+	{
+		return Select<char8_t>().delimiter(ptr, end);
+	}
+
+	const wchar_t * SkipWhiteSpace(const wchar_t * ptr, const wchar_t * end) noexcept
+	{
+		return Select<wchar_t>().notWhiteSpace(ptr, end);
+	}
+
+	const char8_t * SkipWhiteSpace(const char8_t * ptr, const char8_t * end) noexcept
+	{
+		return Select<char8_t>().notWhiteSpace(ptr, end);
+	}
+
+	const wchar_t * SkipNested(const wchar_t * ptr, const wchar_t * end, size_t depth) noexcept
+	{
+		return Select<wchar_t>().skipNested(ptr, end, depth);
+	}
+
+	const char8_t * SkipNested(const char8_t * ptr, const char8_t * end, size_t depth) noexcept
+	{
+		return Select<char8_t>().skipNested(ptr, end, depth);
+	}
+
+	const wchar_t * FindEscapeNeeded(const wchar_t * ptr, const wchar_t * end) noexcept
+	{
+		return Select<wchar_t>().escapeNeeded(ptr, end);
+	}
+
+	const char8_t * FindEscapeNeeded(const char8_t * ptr, const char8_t * end) noexcept
+	{
+		return Select<char8_t>().escapeNeeded(ptr, end);
+	}
+
+	const char8_t * CopyAscii(const char8_t * ptr, const char8_t * end, wchar_t * out) noexcept
+	{
+		return Select<char8_t>().copyAscii(ptr, end, out);
+	}
+
+	const wchar_t * CopyAscii(const wchar_t * ptr, const wchar_t * end, char8_t * out) noexcept
+	{
+		return Select<wchar_t>().copyAscii(ptr, end, out);
+	}
+}
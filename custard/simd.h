@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+
+namespace custard::simd
+{
+	//
+	// Block scanners for the JSON tokenizer. Each function returns the first position in [ptr, end)
+	// that matches, or end. Code units up to U+0020 are treated as white space.
+	//
+
+	// '"' or '\'
+	const wchar_t * FindQuoteOrEscape(const wchar_t * ptr, const wchar_t * end) noexcept;
+	const char8_t * FindQuoteOrEscape(const char8_t * ptr, const char8_t * end) noexcept;
+
+	// One of ",[]{}", '\' or white space
+	const wchar_t * FindDelimiter(const wchar_t * ptr, const wchar_t * end) noexcept;
+	const char8_t * FindDelimiter(const char8_t * ptr, const char8_t * end) noexcept;
+
+	// Anything but white space
+	const wchar_t * SkipWhiteSpace(const wchar_t * ptr, const wchar_t * end) noexcept;
+	const char8_t * SkipWhiteSpace(const char8_t * ptr, const char8_t * end) noexcept;
+
+	// '"', '\' or a control character, i.e. anything a JSON string has to escape
+	const wchar_t * FindEscapeNeeded(const wchar_t * ptr, const wchar_t * end) noexcept;
+	const char8_t * FindEscapeNeeded(const char8_t * ptr, const char8_t * end) noexcept;
+
+	// Copies the leading run of ASCII code units to out, each converted to the other width, and
+	// returns the first code unit that is not ASCII, or end.
+	const char8_t * CopyAscii(const char8_t * ptr, const char8_t * end, wchar_t * out) noexcept;
+	const wchar_t * CopyAscii(const wchar_t * ptr, const wchar_t * end, char8_t * out) noexcept;
+
+	// Just past the bracket that closes the outermost of depth open levels, skipping over strings.
+	// ptr must not be inside a string. Returns nullptr if the text ends before they all close.
+	const wchar_t * SkipNested(const wchar_t * ptr, const wchar_t * end, size_t depth) noexcept;
+	const char8_t * SkipNested(const char8_t * ptr, const char8_t * end, size_t depth) noexcept;
+}
@@ -0,0 +1,130 @@
+//
+// simd.inl
+//
+// Generic block kernels. simd.cpp includes this file once per instruction set, inside a namespace
+// that defines Lanes<N> (vector operations on N-byte code units) for that instruction set.
+//
+
+template <Match M, typename CharT>
+inline uint32_t Classify(typename Lanes<sizeof(CharT)>::Vector v) noexcept
+{
+	using L = Lanes<sizeof(CharT)>;
+
+	if constexpr (M == Match::QuoteOrEscape)
+	{
+		return L::MoveMask(L::Or(L::Equal(v, L::Splat('"')), L::Equal(v, L::Splat('\\'))));
+	}
+	else if constexpr (M == Match::Delimiter)
+	{
+		// '[' | 0x20 == '{' and ']' | 0x20 == '}'
+		auto folded = L::Or(v, L::Splat(0x20));
+		auto brackets = L::Or(L::Equal(folded, L::Splat('{')), L::Equal(folded, L::Splat('}')));
+		auto others = L::Or(L::Equal(v, L::Splat(',')), L::Equal(v, L::Splat('\\')));
+
+		return L::MoveMask(L::Or(L::Or(brackets, others), L::WhiteSpace(v)));
+	}
+	else if constexpr (M == Match::NotWhiteSpace)
+	{
+		return ~L::MoveMask(L::WhiteSpace(v)) & L::All;
+	}
+	else if constexpr (M == Match::EscapeNeeded)
+	{
+		auto control = L::MoveMask(L::WhiteSpace(v)) & ~L::MoveMask(L::Equal(v, L::Splat(' ')));
+		return L::MoveMask(L::Or(L::Equal(v, L::Splat('"')), L::Equal(v, L::Splat('\\')))) | control;
+	}
+	else
+	{
+		return ~L::MoveMask(L::Ascii(v)) & L::All;
+	}
+}
+
+template <Match M, typename CharT>
+const CharT * Find(const CharT * ptr, const CharT * end) noexcept
+{
+	using L = Lanes<sizeof(CharT)>;
+
+	while ((size_t) (end - ptr) >= L::Count)
+	{
+		if (auto mask = Classify<M, CharT>(L::Load(ptr)))
+		{
+			return ptr + std::countr_zero(mask) / sizeof(CharT);
+		}
+
+		ptr += L::Count;
+	}
+
+	return FindScalar<M>(ptr, end);
+}
+
+// Whole blocks of ASCII are converted with a fixed trip count, which compilers turn into packs or
+// unpacks for the instruction set in effect.
+template <typename CharT, typename OtherT>
+const CharT * CopyAscii(const CharT * ptr, const CharT * end, OtherT * out) noexcept
+{
+	using L = Lanes<sizeof(CharT)>;
+
+	while ((size_t) (end - ptr) >= L::Count)
+	{
+		if (Classify<Match::NonAscii, CharT>(L::Load(ptr)))
+		{
+			break;
+		}
+
+		for (size_t i = 0; i < L::Count; i++)
+		{
+			out[i] = (OtherT) ptr[i];
+		}
+
+		ptr += L::Count;
+		out += L::Count;
+	}
+
+	return CopyAsciiScalar(ptr, end, out);
+}
+
+template <typename CharT>
+inline Structurals ClassifyBlock(const CharT * ptr) noexcept
+{
+	using L = Lanes<sizeof(CharT)>;
+
+	Structurals block{};
+
+	for (size_t i = 0; i < 64; i += L::Count)
+	{
+		auto v = L::Load(ptr + i);
+		auto folded = L::Or(v, L::Splat(0x20));
+
+		block.quote |= (uint64_t) Compress<sizeof(CharT)>(L::MoveMask(L::Equal(v, L::Splat('"')))) << i;
+		block.backslash |= (uint64_t) Compress<sizeof(CharT)>(L::MoveMask(L::Equal(v, L::Splat('\\')))) << i;
+		block.open |= (uint64_t) Compress<sizeof(CharT)>(L::MoveMask(L::Equal(folded, L::Splat('{')))) << i;
+		block.close |= (uint64_t) Compress<sizeof(CharT)>(L::MoveMask(L::Equal(folded, L::Splat('}')))) << i;
+	}
+
+	return block;
+}
+
+template <typename CharT>
+const CharT * SkipNested(const CharT * ptr, const CharT * end, size_t depth) noexcept
+{
+	NestingScanner scanner(depth);
+
+	for (; end - ptr >= 64; ptr += 64)
+	{
+		if (auto pos = scanner.Next(ClassifyBlock(ptr)); pos < 64)
+		{
+			return ptr + pos + 1;
+		}
+	}
+
+	// The tail is padded with white space, which never changes the state.
+	CharT tail[64];
+
+	std::fill(std::copy(ptr, end, tail), tail + 64, CharT(' '));
+
+	if (auto pos = scanner.Next(ClassifyBlock(tail)); pos < (size_t) (end - ptr))
+	{
+		return ptr + pos + 1;
+	}
+
+	return nullptr;
+}
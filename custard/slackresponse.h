@@ -0,0 +1,72 @@
+#pragma once
+
+#include "jsonschema.h"
+
+#include <optional>
+#include <string_view>
+#include <tuple>
+
+//
+// https://api.slack.com/methods/chat.postMessage
+//
+
+namespace custard
+{
+	struct SlackApiResponse
+	{
+		std::optional<bool> ok;
+
+		struct Bot
+		{
+			std::wstring_view name;
+
+			struct Icons
+			{
+				std::wstring_view image_36;
+				std::wstring_view image_48;
+				std::wstring_view image_76;
+
+			} icons;
+
+		} bot;
+
+		struct Message
+		{
+			Bot bot_profile;
+
+		} message;
+	};
+}
+
+template <>
+struct custard::JsonSchema<custard::SlackApiResponse>
+{
+	static constexpr auto Fields = std::make_tuple(
+		JsonField(L"ok", &SlackApiResponse::ok),
+		JsonField(L"bot", &SlackApiResponse::bot),
+		JsonField(L"message", &SlackApiResponse::message));
+};
+
+template <>
+struct custard::JsonSchema<custard::SlackApiResponse::Bot>
+{
+	static constexpr auto Fields = std::make_tuple(
+		JsonField(L"name", &SlackApiResponse::Bot::name),
+		JsonField(L"icons", &SlackApiResponse::Bot::icons));
+};
+
+template <>
+struct custard::JsonSchema<custard::SlackApiResponse::Bot::Icons>
+{
+	static constexpr auto Fields = std::make_tuple(
+		JsonField(L"image_36", &SlackApiResponse::Bot::Icons::image_36),
+		JsonField(L"image_48", &SlackApiResponse::Bot::Icons::image_48),
+		JsonField(L"image_76", &SlackApiResponse::Bot::Icons::image_76));
+};
+
+template <>
+struct custard::JsonSchema<custard::SlackApiResponse::Message>
+{
+	static constexpr auto Fields = std::make_tuple(
+		JsonField(L"bot_profile", &SlackApiResponse::Message::bot_profile));
+};
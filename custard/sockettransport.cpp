@@ -0,0 +1,998 @@
+#include "sockettransport.h"
+#include "utf.h"
+
+#if defined(_WIN32)
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <system_error>
+#include <thread>
+#include <utility>
+
+namespace custard
+{
+	//
+	// HttpResponseReader
+	//
+
+	static char AsciiLower(char ch) noexcept
+	{
+		return (ch >= 'A' && ch <= 'Z') ? (char) (ch + ('a' - 'A')) : ch;
+	}
+
+	static bool EqualsIgnoreCase(std::string_view a, std::string_view b) noexcept
+	{
+		return std::equal(a.begin(), a.end(), b.begin(), b.end(), [](char x, char y) { return AsciiLower(x) == AsciiLower(y); });
+	}
+
+	static bool ContainsToken(std::string_view list, std::string_view token) noexcept
+	{
+		while (!list.empty())
+		{
+			auto item = list.substr(0, list.find(','));
+			list.remove_prefix(std::min(item.size() + 1, list.size()));
+
+			while (!item.empty() && (item.front() == ' ' || item.front() == '\t'))
+			{
+				item.remove_prefix(1);
+			}
+
+			while (!item.empty() && (item.back() == ' ' || item.back() == '\t'))
+			{
+				item.remove_suffix(1);
+			}
+
+			if (EqualsIgnoreCase(item, token))
+			{
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	static size_t ParseSize(std::string_view digits, int base)
+	{
+		size_t value = 0;
+
+		if (digits.empty())
+		{
+			throw std::runtime_error("Invalid response.");
+		}
+
+		for (auto ch : digits)
+		{
+			int digit = (ch >= '0' && ch <= '9') ? ch - '0' : (base == 16 && ch >= 'a' && ch <= 'f') ? ch - 'a' + 10 : (base == 16 && ch >= 'A' && ch <= 'F') ? ch - 'A' + 10 : -1;
+
+			if (digit < 0 || value > (SIZE_MAX - digit) / base)
+			{
+				throw std::runtime_error("Invalid response.");
+			}
+
+			value = value * base + digit;
+		}
+
+		return value;
+	}
+
+	void HttpResponseReader::ParseHead(std::string_view head)
+	{
+		// HTTP/1.1 200 OK
+		if (head.size() < 12 || !head.starts_with("HTTP/1.") || head[8] != ' ')
+		{
+			throw std::runtime_error("Invalid response.");
+		}
+
+		bool http10 = (head[7] == '0');
+		m_response.status = (uint32_t) ParseSize(head.substr(9, 3), 10);
+		m_response.headers = ConvertFrom(std::u8string_view((const char8_t *) head.data(), head.size()));
+
+		bool chunked = false;
+		bool hasLength = false;
+		bool close = http10;
+
+		for (auto rest = head.substr(head.find("\r\n") + 2); !rest.empty();)
+		{
+			auto line = rest.substr(0, rest.find("\r\n"));
+			rest.remove_prefix(std::min(line.size() + 2, rest.size()));
+
+			auto colon = line.find(':');
+
+			if (colon == std::string_view::npos)
+			{
+				continue;
+			}
+
+			auto name = line.substr(0, colon);
+			auto value = line.substr(colon + 1);
+
+			while (!value.empty() && (value.front() == ' ' || value.front() == '\t'))
+			{
+				value.remove_prefix(1);
+			}
+
+			while (!value.empty() && (value.back() == ' ' || value.back() == '\t'))
+			{
+				value.remove_suffix(1);
+			}
+
+			if (EqualsIgnoreCase(name, "Content-Length"))
+			{
+				m_remaining = ParseSize(value, 10);
+				hasLength = true;
+			}
+			else if (EqualsIgnoreCase(name, "Transfer-Encoding"))
+			{
+				chunked = ContainsToken(value, "chunked");
+			}
+			else if (EqualsIgnoreCase(name, "Connection"))
+			{
+				if (ContainsToken(value, "close"))
+				{
+					close = true;
+				}
+				else if (ContainsToken(value, "keep-alive"))
+				{
+					close = false;
+				}
+			}
+		}
+
+		m_keepAlive = !close;
+
+		if (m_headRequest || m_response.status == 204 || m_response.status == 304)
+		{
+			m_phase = Phase::Done;
+		}
+		else if (chunked)
+		{
+			m_phase = Phase::ChunkSize;
+		}
+		else if (hasLength)
+		{
+			m_phase = (m_remaining > 0) ? Phase::Content : Phase::Done;
+			m_response.content.reserve(m_remaining);
+		}
+		else
+		{
+			m_phase = Phase::UntilClose;
+			m_keepAlive = false;
+		}
+	}
+
+	bool HttpResponseReader::Feed(const char * data, size_t size)
+	{
+		m_started = m_started || size > 0;
+		m_buffer.append(data, size);
+
+		std::string_view input = m_buffer;
+
+		auto take = [this, &input]()
+		{
+			auto count = std::min(m_remaining, input.size());
+			auto bytes = (const std::byte *) input.data();
+
+			m_response.content.insert(m_response.content.end(), bytes, bytes + count);
+			m_remaining -= count;
+			input.remove_prefix(count);
+		};
+
+		for (bool more = true; more && m_phase != Phase::Done;)
+		{
+			switch (m_phase)
+			{
+			case Phase::Head:
+				if (auto pos = input.find("\r\n\r\n"); pos != std::string_view::npos)
+				{
+					ParseHead(input.substr(0, pos + 4));
+					input.remove_prefix(pos + 4);
+
+					// An interim response, such as 100 Continue, precedes the real one.
+					if (m_response.status < 200)
+					{
+						m_response = {};
+						m_phase = Phase::Head;
+					}
+				}
+				else if (input.size() > MaxHeadLength)
+				{
+					throw std::runtime_error("Response header too large.");
+				}
+				else
+				{
+					more = false;
+				}
+				break;
+
+			case Phase::Content:
+				take();
+				more = !input.empty();
+				m_phase = (m_remaining == 0) ? Phase::Done : Phase::Content;
+				break;
+
+			case Phase::ChunkSize:
+				if (auto pos = input.find("\r\n"); pos != std::string_view::npos)
+				{
+					auto line = input.substr(0, pos);
+					m_remaining = ParseSize(line.substr(0, std::min(line.find(';'), line.find(' '))), 16);
+					input.remove_prefix(pos + 2);
+					m_phase = (m_remaining == 0) ? Phase::Trailer : Phase::ChunkData;
+				}
+				else
+				{
+					more = false;
+				}
+				break;
+
+			case Phase::ChunkData:
+				take();
+				more = !input.empty();
+				m_phase = (m_remaining == 0) ? Phase::ChunkEnd : Phase::ChunkData;
+				break;
+
+			case Phase::ChunkEnd:
+				if (input.size() < 2)
+				{
+					more = false;
+				}
+				else if (input.starts_with("\r\n"))
+				{
+					input.remove_prefix(2);
+					m_phase = Phase::ChunkSize;
+				}
+				else
+				{
+					throw std::runtime_error("Invalid response.");
+				}
+				break;
+
+			case Phase::Trailer:
+				if (auto pos = input.find("\r\n"); pos != std::string_view::npos)
+				{
+					input.remove_prefix(pos + 2);
+					m_phase = (pos == 0) ? Phase::Done : Phase::Trailer;
+				}
+				else
+				{
+					more = false;
+				}
+				break;
+
+			case Phase::UntilClose:
+				m_remaining = input.size();
+				take();
+				more = false;
+				break;
+
+			case Phase::Done:
+				break;
+			}
+		}
+
+		m_buffer.erase(0, m_buffer.size() - input.size());
+		return m_phase == Phase::Done;
+	}
+
+	bool HttpResponseReader::Close()
+	{
+		if (m_phase == Phase::UntilClose)
+		{
+			m_phase = Phase::Done;
+		}
+
+		return m_phase == Phase::Done;
+	}
+
+
+	//
+	// Sockets
+	//
+
+#if defined(_WIN32)
+	using SocketHandle = SOCKET;
+	using SocketLength = int;
+
+	static constexpr SocketHandle NoSocket = INVALID_SOCKET;
+	static constexpr int SendFlags = 0;
+
+	static int LastSocketError() noexcept
+	{
+		return ::WSAGetLastError();
+	}
+
+	static bool WouldBlock(int error) noexcept
+	{
+		return error == WSAEWOULDBLOCK;
+	}
+
+	static void CloseSocket(SocketHandle handle) noexcept
+	{
+		::closesocket(handle);
+	}
+
+	static void SetNonBlocking(SocketHandle handle)
+	{
+		u_long on = 1;
+
+		if (::ioctlsocket(handle, FIONBIO, &on) != 0)
+		{
+			throw std::system_error(LastSocketError(), std::system_category(), "ioctlsocket");
+		}
+	}
+
+	static int Poll(pollfd * fds, size_t count, int timeout) noexcept
+	{
+		return ::WSAPoll(fds, (ULONG) count, timeout);
+	}
+
+	struct WinsockLibrary
+	{
+		WinsockLibrary()
+		{
+			WSADATA data{};
+
+			if (auto error = ::WSAStartup(MAKEWORD(2, 2), &data))
+			{
+				throw std::system_error(error, std::system_category(), "WSAStartup");
+			}
+		}
+
+		~WinsockLibrary() noexcept
+		{
+			::WSACleanup();
+		}
+	};
+#else
+	using SocketHandle = int;
+	using SocketLength = socklen_t;
+
+	static constexpr SocketHandle NoSocket = -1;
+#if defined(MSG_NOSIGNAL)
+	static constexpr int SendFlags = MSG_NOSIGNAL;
+#else
+	static constexpr int SendFlags = 0;
+#endif
+
+	static int LastSocketError() noexcept
+	{
+		return errno;
+	}
+
+	static bool WouldBlock(int error) noexcept
+	{
+		return error == EWOULDBLOCK || error == EAGAIN || error == EINPROGRESS;
+	}
+
+	static void CloseSocket(SocketHandle handle) noexcept
+	{
+		::close(handle);
+	}
+
+	static void SetNonBlocking(SocketHandle handle)
+	{
+		if (::fcntl(handle, F_SETFL, ::fcntl(handle, F_GETFL) | O_NONBLOCK) == -1)
+		{
+			throw std::system_error(LastSocketError(), std::system_category(), "fcntl");
+		}
+	}
+
+	static int Poll(pollfd * fds, size_t count, int timeout) noexcept
+	{
+		return ::poll(fds, (nfds_t) count, timeout);
+	}
+#endif
+
+	class Socket
+	{
+		SocketHandle m_handle;
+
+	public:
+		explicit Socket(SocketHandle handle = NoSocket) noexcept : m_handle(handle)
+		{}
+
+		Socket(Socket && other) noexcept : m_handle(std::exchange(other.m_handle, NoSocket))
+		{}
+
+		Socket & operator=(Socket && other) noexcept
+		{
+			Reset(std::exchange(other.m_handle, NoSocket));
+			return *this;
+		}
+
+		~Socket() noexcept
+		{
+			Reset();
+		}
+
+		void Reset(SocketHandle handle = NoSocket) noexcept
+		{
+			if (m_handle != NoSocket)
+			{
+				CloseSocket(m_handle);
+			}
+
+			m_handle = handle;
+		}
+
+		operator SocketHandle() const noexcept
+		{
+			return m_handle;
+		}
+
+		explicit operator bool() const noexcept
+		{
+			return m_handle != NoSocket;
+		}
+	};
+
+	static Socket OpenSocket(int family)
+	{
+		Socket socket(::socket(family, SOCK_STREAM, IPPROTO_TCP));
+
+		if (!socket)
+		{
+			throw std::system_error(LastSocketError(), std::system_category(), "socket");
+		}
+
+		SetNonBlocking(socket);
+		return socket;
+	}
+
+	// A connected pair of loopback sockets, which works the same everywhere, to wake a poll.
+	static std::pair<Socket, Socket> OpenWakePair()
+	{
+		sockaddr_in address{};
+		address.sin_family = AF_INET;
+		address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+		SocketLength length = sizeof(address);
+		Socket listener(::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP));
+		Socket writer(::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP));
+
+		if (!listener || !writer ||
+			::bind(listener, (sockaddr *) &address, length) != 0 ||
+			::listen(listener, 1) != 0 ||
+			::getsockname(listener, (sockaddr *) &address, &length) != 0 ||
+			::connect(writer, (sockaddr *) &address, length) != 0)
+		{
+			throw std::system_error(LastSocketError(), std::system_category(), "OpenWakePair");
+		}
+
+		Socket reader(::accept(listener, nullptr, nullptr));
+
+		if (!reader)
+		{
+			throw std::system_error(LastSocketError(), std::system_category(), "accept");
+		}
+
+		SetNonBlocking(reader);
+		SetNonBlocking(writer);
+		return { std::move(reader), std::move(writer) };
+	}
+
+	static std::string ToUtf8(std::wstring_view wstr)
+	{
+		auto utf8 = ConvertFrom(wstr);
+		return { (const char *) utf8.data(), utf8.size() };
+	}
+
+
+	//
+	// SocketTransport
+	//
+
+	struct SocketTransport::Loop
+	{
+		struct Address
+		{
+			sockaddr_storage storage;
+			SocketLength length;
+		};
+
+		struct Idle
+		{
+			Socket socket;
+			std::chrono::steady_clock::time_point since;
+		};
+
+		struct Exchange;
+
+		struct Host
+		{
+			std::string name;
+			std::string service;
+			std::vector<Address> addresses;
+			size_t open = 0; // sockets to the host, busy or idle
+			std::vector<Idle> idle;
+			std::deque<std::unique_ptr<Exchange>> waiting;
+		};
+
+		enum class Phase { Connecting, Sending, Receiving, Finished };
+
+		struct Exchange
+		{
+			HttpRequest request;
+			Completion done;
+			Host * host = nullptr;
+			Socket socket;
+			bool holding = false; // one of the host's open sockets
+			bool reused = false;
+			size_t address = 0;
+			Phase phase = Phase::Connecting;
+			std::string message;
+			size_t sent = 0;
+			HttpResponseReader reader;
+
+			Exchange(HttpRequest && request, Completion && done) :
+				request(std::move(request)), done(std::move(done)), reader(this->request.verb == L"HEAD")
+			{}
+		};
+
+		std::mutex m_mutex;
+		bool m_stopping = false;
+		std::vector<std::unique_ptr<Exchange>> m_incoming;
+
+		Socket m_wakeReader;
+		Socket m_wakeWriter;
+		std::map<std::string, Host> m_hosts;
+		std::vector<std::unique_ptr<Exchange>> m_active;
+		std::thread m_thread;
+
+		Loop()
+		{
+			std::tie(m_wakeReader, m_wakeWriter) = OpenWakePair();
+			m_thread = std::thread(&Loop::Run, this);
+		}
+
+		~Loop() noexcept
+		{
+			{
+				std::lock_guard lock(m_mutex);
+				m_stopping = true;
+			}
+
+			Wake();
+			m_thread.join();
+		}
+
+		void Post(std::unique_ptr<Exchange> exchange)
+		{
+			{
+				std::lock_guard lock(m_mutex);
+				m_incoming.push_back(std::move(exchange));
+			}
+
+			Wake();
+		}
+
+		void Wake() noexcept
+		{
+			char byte = 0;
+			::send(m_wakeWriter, &byte, 1, SendFlags);
+		}
+
+		void Run()
+		{
+			std::vector<pollfd> fds;
+
+			for (;;)
+			{
+				std::vector<std::unique_ptr<Exchange>> incoming;
+				{
+					std::lock_guard lock(m_mutex);
+
+					if (m_stopping)
+					{
+						break;
+					}
+
+					incoming.swap(m_incoming);
+				}
+
+				for (auto & exchange : incoming)
+				{
+					Begin(std::move(exchange));
+				}
+
+				bool idle = ExpireIdle();
+
+				fds.clear();
+				fds.push_back({ m_wakeReader, POLLIN, 0 });
+
+				for (auto & exchange : m_active)
+				{
+					fds.push_back({ exchange->socket, (short) ((exchange->phase == Phase::Receiving) ? POLLIN : POLLOUT), 0 });
+				}
+
+				if (Poll(fds.data(), fds.size(), idle ? 1000 : -1) < 0)
+				{
+					continue;
+				}
+
+				if (fds[0].revents)
+				{
+					char bytes[64];
+					while (::recv(m_wakeReader, bytes, sizeof(bytes), 0) > 0);
+				}
+
+				// Exchanges begun while stepping are appended, and polled next time round.
+				for (size_t i = 1; i < fds.size(); ++i)
+				{
+					if (fds[i].revents)
+					{
+						Step(*m_active[i - 1]);
+					}
+				}
+
+				std::erase_if(m_active, [](auto & exchange) { return exchange->phase == Phase::Finished; });
+			}
+
+			auto error = std::make_exception_ptr(std::runtime_error("The transport was destroyed."));
+
+			for (auto & exchange : m_active)
+			{
+				if (exchange->phase != Phase::Finished)
+				{
+					exchange->done(error, {});
+				}
+			}
+
+			for (auto & [key, host] : m_hosts)
+			{
+				for (auto & exchange : host.waiting)
+				{
+					exchange->done(error, {});
+				}
+			}
+
+			for (auto & exchange : m_incoming)
+			{
+				exchange->done(error, {});
+			}
+		}
+
+		void Begin(std::unique_ptr<Exchange> exchange)
+		{
+			try
+			{
+				auto & request = exchange->request;
+
+				if (request.secure)
+				{
+					throw std::runtime_error("SocketTransport does not support TLS.");
+				}
+
+				auto name = ToUtf8(request.host);
+				auto service = std::to_string(request.port);
+				auto & host = m_hosts[name + ':' + service];
+
+				if (host.name.empty())
+				{
+					host.name = std::move(name);
+					host.service = std::move(service);
+				}
+
+				exchange->host = &host;
+
+				if (host.idle.empty() && host.open == MaxPerHost)
+				{
+					host.waiting.push_back(std::move(exchange));
+					return;
+				}
+
+				exchange->message = FormatRequest(request);
+				exchange->holding = true;
+
+				if (!host.idle.empty())
+				{
+					exchange->socket = std::move(host.idle.back().socket);
+					exchange->reused = true;
+					exchange->phase = Phase::Sending;
+					host.idle.pop_back();
+				}
+				else
+				{
+					++host.open;
+					Connect(*exchange);
+				}
+
+				m_active.push_back(std::move(exchange));
+			}
+			catch (...)
+			{
+				if (exchange)
+				{
+					Fail(*exchange, std::current_exception());
+				}
+			}
+		}
+
+		static std::string FormatRequest(const HttpRequest & request)
+		{
+			std::string message;
+			message += ToUtf8(request.verb);
+			message += ' ';
+			message += ToUtf8(request.path);
+			message += " HTTP/1.1\r\nHost: ";
+			message += ToUtf8(request.host);
+
+			if (request.port != 80)
+			{
+				message += ':';
+				message += std::to_string(request.port);
+			}
+
+			message += "\r\nUser-Agent: Custard/1.0\r\n";
+
+			if (!request.content.empty() || request.verb == L"POST" || request.verb == L"PUT")
+			{
+				message += "Content-Length: ";
+				message += std::to_string(request.content.size());
+				message += "\r\n";
+			}
+
+			message += ToUtf8(request.headers);
+			message += "\r\n";
+			message.append((const char *) request.content.data(), request.content.size());
+			return message;
+		}
+
+		// Opens a socket to the exchange's current address, or the next one that can be tried.
+		void Connect(Exchange & exchange)
+		{
+			auto & host = *exchange.host;
+
+			if (host.addresses.empty())
+			{
+				addrinfo hints{};
+				hints.ai_family = AF_UNSPEC;
+				hints.ai_socktype = SOCK_STREAM;
+
+				addrinfo * list = nullptr;
+
+				if (::getaddrinfo(host.name.c_str(), host.service.c_str(), &hints, &list) != 0 || list == nullptr)
+				{
+					throw std::runtime_error("Cannot resolve " + host.name + ".");
+				}
+
+				for (auto info = list; info; info = info->ai_next)
+				{
+					Address address{};
+					std::memcpy(&address.storage, info->ai_addr, info->ai_addrlen);
+					address.length = (SocketLength) info->ai_addrlen;
+					host.addresses.push_back(address);
+				}
+
+				::freeaddrinfo(list);
+			}
+
+			int error = 0;
+
+			for (; exchange.address < host.addresses.size(); ++exchange.address)
+			{
+				auto & address = host.addresses[exchange.address];
+				auto socket = OpenSocket(address.storage.ss_family);
+
+				int on = 1;
+				::setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, (const char *) &on, sizeof(on));
+
+				if (::connect(socket, (const sockaddr *) &address.storage, address.length) == 0 || WouldBlock(error = LastSocketError()))
+				{
+					exchange.socket = std::move(socket);
+					exchange.phase = Phase::Connecting;
+					return;
+				}
+			}
+
+			throw std::system_error(error, std::system_category(), "connect");
+		}
+
+		void Step(Exchange & exchange)
+		{
+			try
+			{
+				switch (exchange.phase)
+				{
+				case Phase::Connecting:
+				{
+					int error = 0;
+					SocketLength length = sizeof(error);
+					::getsockopt(exchange.socket, SOL_SOCKET, SO_ERROR, (char *) &error, &length);
+
+					if (error != 0)
+					{
+						exchange.socket.Reset();
+
+						if (++exchange.address == exchange.host->addresses.size())
+						{
+							throw std::system_error(error, std::system_category(), "connect");
+						}
+
+						Connect(exchange);
+						return;
+					}
+
+					exchange.phase = Phase::Sending;
+				}
+					[[fallthrough]];
+
+				case Phase::Sending:
+					while (exchange.sent < exchange.message.size())
+					{
+						auto size = std::min<size_t>(exchange.message.size() - exchange.sent, INT32_MAX);
+						auto sent = ::send(exchange.socket, exchange.message.data() + exchange.sent, (int) size, SendFlags);
+
+						if (sent < 0)
+						{
+							if (auto error = LastSocketError(); !WouldBlock(error))
+							{
+								Broken(exchange, std::system_error(error, std::system_category(), "send"));
+							}
+							return;
+						}
+
+						exchange.sent += sent;
+					}
+
+					exchange.phase = Phase::Receiving;
+					return;
+
+				case Phase::Receiving:
+					for (;;)
+					{
+						char buffer[16 * 1024];
+						auto received = ::recv(exchange.socket, buffer, (int) sizeof(buffer), 0);
+
+						if (received > 0)
+						{
+							if (exchange.reader.Feed(buffer, received))
+							{
+								Finish(exchange);
+								return;
+							}
+						}
+						else if (received == 0)
+						{
+							if (exchange.reader.Close())
+							{
+								Finish(exchange);
+							}
+							else
+							{
+								Broken(exchange, std::runtime_error("Connection closed before the response was complete."));
+							}
+							return;
+						}
+						else
+						{
+							if (auto error = LastSocketError(); !WouldBlock(error))
+							{
+								Broken(exchange, std::system_error(error, std::system_category(), "recv"));
+							}
+							return;
+						}
+					}
+
+				case Phase::Finished:
+					return;
+				}
+			}
+			catch (...)
+			{
+				Fail(exchange, std::current_exception());
+			}
+		}
+
+		//
+		// A server may close a kept-alive socket just as it is reused; a request that got no answer at all
+		// on one is sent again on a fresh socket.
+		//
+		template <typename Error>
+		void Broken(Exchange & exchange, const Error & error)
+		{
+			if (!exchange.reused || exchange.reader.Started())
+			{
+				throw error;
+			}
+
+			exchange.socket.Reset();
+			exchange.reused = false;
+			exchange.address = 0;
+			exchange.sent = 0;
+			Connect(exchange);
+		}
+
+		void Finish(Exchange & exchange)
+		{
+			Release(exchange, exchange.reader.KeepAlive());
+			exchange.done(nullptr, std::move(exchange.reader.Result()));
+		}
+
+		void Fail(Exchange & exchange, std::exception_ptr error)
+		{
+			if (exchange.holding)
+			{
+				Release(exchange, false);
+			}
+
+			exchange.phase = Phase::Finished;
+			exchange.done(error, {});
+		}
+
+		// Returns the exchange's socket to its host, and lets the next waiting request have it.
+		void Release(Exchange & exchange, bool keepAlive)
+		{
+			auto & host = *exchange.host;
+
+			if (keepAlive)
+			{
+				host.idle.push_back({ std::move(exchange.socket), std::chrono::steady_clock::now() });
+			}
+			else
+			{
+				exchange.socket.Reset();
+				--host.open;
+			}
+
+			exchange.holding = false;
+			exchange.phase = Phase::Finished;
+
+			if (!host.waiting.empty())
+			{
+				auto next = std::move(host.waiting.front());
+				host.waiting.pop_front();
+				Begin(std::move(next));
+			}
+		}
+
+		// Closes sockets that have been idle too long, and returns whether any idle ones remain.
+		bool ExpireIdle()
+		{
+			auto now = std::chrono::steady_clock::now();
+			bool remain = false;
+
+			for (auto & [key, host] : m_hosts)
+			{
+				host.open -= std::erase_if(host.idle, [now](auto & idle) { return now - idle.since > IdleTimeout; });
+				remain = remain || !host.idle.empty();
+			}
+
+			return remain;
+		}
+	};
+
+	SocketTransport::SocketTransport(size_t threads)
+	{
+#if defined(_WIN32)
+		static const WinsockLibrary library;
+#endif
+		for (size_t i = 0; i < std::max<size_t>(threads, 1); ++i)
+		{
+			m_loops.push_back(std::make_unique<Loop>());
+		}
+	}
+
+	SocketTransport::~SocketTransport() noexcept = default;
+
+	void SocketTransport::Start(HttpRequest && request, Completion done)
+	{
+		auto & loop = *m_loops[std::hash<std::wstring>{}(request.host) % m_loops.size()];
+		loop.Post(std::make_unique<Loop::Exchange>(std::move(request), std::move(done)));
+	}
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include "transport.h"
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace custard
+{
+	//
+	// Reads an HTTP/1.1 response as it arrives, in pieces of any size. The content is framed by
+	// Content-Length, the chunked transfer coding or, failing both, the end of the connection.
+	//
+	class HttpResponseReader
+	{
+		enum class Phase { Head, Content, ChunkSize, ChunkData, ChunkEnd, Trailer, UntilClose, Done };
+
+		Phase m_phase = Phase::Head;
+		bool m_headRequest;
+		bool m_started = false;
+		bool m_keepAlive = false;
+		size_t m_remaining = 0; // of the content or of the current chunk
+		std::string m_buffer;   // received but not yet consumed
+		HttpResponse m_response;
+
+	public:
+		static constexpr size_t MaxHeadLength = 64 * 1024;
+
+		// The response to a HEAD request has no content, whatever its headers say.
+		explicit HttpResponseReader(bool headRequest = false) noexcept : m_headRequest(headRequest)
+		{}
+
+		// Consumes received bytes and returns true once the response is complete.
+		bool Feed(const char * data, size_t size);
+
+		// The server closed the connection; returns true if that completes the response.
+		bool Close();
+
+		bool Started() const noexcept
+		{
+			return m_started;
+		}
+
+		// Whether the connection can carry another request once the response is complete.
+		bool KeepAlive() const noexcept
+		{
+			return m_keepAlive;
+		}
+
+		HttpResponse & Result() noexcept
+		{
+			return m_response;
+		}
+
+	private:
+		void ParseHead(std::string_view head);
+	};
+
+	//
+	// A Transport on plain, non-blocking sockets, for http:// servers such as local stand-ins. It has no
+	// TLS, so https:// requests fail; on Windows, WinHttpTransport carries those.
+	//
+	// Each thread polls all of its sockets at once. Requests to one host go to the same thread, which
+	// keeps at most MaxPerHost sockets open to it and holds the rest of the requests until one is free.
+	// A socket idle for IdleTimeout is closed. Host names are resolved once per thread, on that thread.
+	//
+	class SocketTransport : public Transport
+	{
+		struct Loop;
+
+		std::vector<std::unique_ptr<Loop>> m_loops;
+
+	public:
+		static constexpr size_t MaxPerHost = 6;
+		static constexpr std::chrono::seconds IdleTimeout{ 90 };
+
+		explicit SocketTransport(size_t threads = 1);
+		~SocketTransport() noexcept override;
+
+		void Start(HttpRequest && request, Completion done) override;
+
+		SocketTransport(const SocketTransport &) = delete;
+		SocketTransport & operator=(const SocketTransport &) = delete;
+	};
+}
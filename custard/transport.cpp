@@ -0,0 +1,187 @@
+#include "transport.h"
+#include "sockettransport.h"
+
+#if defined(_WIN32)
+#include "https.h"
+#endif
+
+#include <stdexcept>
+
+namespace custard
+{
+	static wchar_t AsciiLower(wchar_t ch) noexcept
+	{
+		return (ch >= L'A' && ch <= L'Z') ? (wchar_t) (ch + (L'a' - L'A')) : ch;
+	}
+
+	static bool EqualsIgnoreCase(std::wstring_view a, std::wstring_view b) noexcept
+	{
+		if (a.size() != b.size())
+		{
+			return false;
+		}
+
+		for (size_t i = 0; i < a.size(); ++i)
+		{
+			if (AsciiLower(a[i]) != AsciiLower(b[i]))
+			{
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	static std::wstring_view Trim(std::wstring_view str) noexcept
+	{
+		while (!str.empty() && (str.front() == L' ' || str.front() == L'\t'))
+		{
+			str.remove_prefix(1);
+		}
+
+		while (!str.empty() && (str.back() == L' ' || str.back() == L'\t'))
+		{
+			str.remove_suffix(1);
+		}
+
+		return str;
+	}
+
+	std::wstring HttpResponse::Header(std::wstring_view name) const
+	{
+		std::wstring_view rest = headers;
+
+		// The first line is the status line.
+		for (auto pos = rest.find(L"\r\n"); pos != std::wstring_view::npos; pos = rest.find(L"\r\n"))
+		{
+			rest.remove_prefix(pos + 2);
+
+			auto line = rest.substr(0, rest.find(L"\r\n"));
+			auto colon = line.find(L':');
+
+			if (colon != std::wstring_view::npos && EqualsIgnoreCase(Trim(line.substr(0, colon)), name))
+			{
+				return std::wstring(Trim(line.substr(colon + 1)));
+			}
+		}
+
+		return {};
+	}
+
+	std::future<HttpResponse> SendAsync(Transport & transport, HttpRequest && request)
+	{
+		auto promise = std::make_shared<std::promise<HttpResponse>>();
+		auto future = promise->get_future();
+
+		transport.Start(std::move(request), [promise](std::exception_ptr error, HttpResponse && response)
+		{
+			if (error)
+			{
+				promise->set_exception(error);
+			}
+			else
+			{
+				promise->set_value(std::move(response));
+			}
+		});
+
+		return future;
+	}
+
+	std::shared_ptr<Transport> DefaultTransport()
+	{
+#if defined(_WIN32)
+		static auto transport = std::make_shared<WinHttpTransport>();
+#else
+		static auto transport = std::make_shared<SocketTransport>();
+#endif
+		return transport;
+	}
+
+
+	HttpClient::HttpClient(std::wstring_view origin, std::shared_ptr<Transport> transport) : m_transport(std::move(transport))
+	{
+		if (origin.starts_with(L"https://"))
+		{
+			m_secure = true;
+			m_port = 443;
+			origin.remove_prefix(8);
+		}
+		else if (origin.starts_with(L"http://"))
+		{
+			m_secure = false;
+			m_port = 80;
+			origin.remove_prefix(7);
+		}
+		else
+		{
+			throw std::runtime_error("Unsupported scheme.");
+		}
+
+		if (origin.ends_with(L'/'))
+		{
+			origin.remove_suffix(1);
+		}
+
+		if (auto pos = origin.find(L':'); pos != std::wstring_view::npos)
+		{
+			uint32_t port = 0;
+
+			for (auto ch : origin.substr(pos + 1))
+			{
+				if (ch < L'0' || ch > L'9' || (port = port * 10 + (ch - L'0')) > 0xFFFF)
+				{
+					throw std::runtime_error("Invalid URL.");
+				}
+			}
+
+			m_port = (uint16_t) port;
+			origin = origin.substr(0, pos);
+		}
+
+		if (origin.empty() || origin.find(L'/') != std::wstring_view::npos)
+		{
+			throw std::runtime_error("Invalid URL.");
+		}
+
+		m_host = origin;
+	}
+
+	void HttpClient::SetBearerToken(std::wstring_view token)
+	{
+		m_headers = L"Authorization: Bearer ";
+		m_headers += token;
+		m_headers += L"\r\n";
+	}
+
+	void HttpClient::AddContentType(std::wstring_view type)
+	{
+		m_headers += L"Content-Type: ";
+		m_headers += type;
+		m_headers += L"\r\n";
+	}
+
+	HttpRequest HttpClient::MakeRequest(std::wstring_view verb, std::wstring_view path) const
+	{
+		HttpRequest request;
+		request.verb = verb;
+		request.host = m_host;
+		request.port = m_port;
+		request.secure = m_secure;
+		request.path = path;
+		request.headers = m_headers;
+		return request;
+	}
+
+	std::future<HttpResponse> HttpClient::GetAsync(std::wstring_view path)
+	{
+		return SendAsync(*m_transport, MakeRequest(L"GET", path));
+	}
+
+	std::future<HttpResponse> HttpClient::PostAsync(std::wstring_view path, std::span<const std::byte> content)
+	{
+		auto request = MakeRequest(L"POST", path);
+		request.content.assign(content.begin(), content.end());
+		return SendAsync(*m_transport, std::move(request));
+	}
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace custard
+{
+	struct HttpRequest
+	{
+		std::wstring verb = L"GET";
+		std::wstring host;
+		uint16_t port = 443;
+		bool secure = true;
+		std::wstring path = L"/";
+		std::wstring headers; // "Name: value\r\n" lines, as Https sends them
+		std::vector<std::byte> content;
+	};
+
+	struct HttpResponse
+	{
+		uint32_t status = 0;
+		std::wstring headers; // the raw header block, status line first, as Response::Headers() returns it
+		std::vector<std::byte> content;
+
+		// The value of the first header field called name, ignoring case, or an empty string.
+		std::wstring Header(std::wstring_view name) const;
+	};
+
+	//
+	// Carries requests to servers without blocking the caller.
+	//
+	// Start returns at once; done is called exactly once with either the response or the exception that
+	// ended the exchange, from one of the transport's own threads, or before Start returns if the request
+	// could not be started at all. done must not throw. A transport runs any number of requests
+	// concurrently on a fixed, small number of threads.
+	//
+	class Transport
+	{
+	public:
+		using Completion = std::function<void(std::exception_ptr, HttpResponse &&)>;
+
+		virtual ~Transport() noexcept = default;
+
+		virtual void Start(HttpRequest && request, Completion done) = 0;
+	};
+
+	std::future<HttpResponse> SendAsync(Transport & transport, HttpRequest && request);
+
+	// WinHTTP in asynchronous mode on Windows, SocketTransport elsewhere. Shared by the whole process.
+	std::shared_ptr<Transport> DefaultTransport();
+
+	//
+	// The asynchronous counterpart of Https: requests to one origin, such as L"https://slack.com" or
+	// L"http://localhost:8080", with headers common to all of them.
+	//
+	class HttpClient
+	{
+		std::shared_ptr<Transport> m_transport;
+		std::wstring m_host;
+		uint16_t m_port;
+		bool m_secure;
+		std::wstring m_headers;
+
+	public:
+		HttpClient(std::wstring_view origin, std::shared_ptr<Transport> transport = DefaultTransport());
+
+		void SetBearerToken(std::wstring_view token);
+		void AddContentType(std::wstring_view type);
+
+		std::future<HttpResponse> GetAsync(std::wstring_view path);
+		std::future<HttpResponse> PostAsync(std::wstring_view path, std::span<const std::byte> content);
+
+	private:
+		HttpRequest MakeRequest(std::wstring_view verb, std::wstring_view path) const;
+	};
+}
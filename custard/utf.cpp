@@ -0,0 +1,92 @@
+#include "utf.h"
+#include "simd.h"
+
+#include <type_traits>
+
+namespace custard
+{
+	using WideUnit = std::make_unsigned_t<wchar_t>;
+
+	static char32_t DecodeWide(const wchar_t *& ptr, const wchar_t * end) noexcept
+	{
+		char32_t ch = (WideUnit) *ptr++;
+
+		if (ch >= 0xD800 && ch < 0xE000)
+		{
+			if (sizeof(wchar_t) == 2 && ch < 0xDC00 && ptr < end && (WideUnit) *ptr >= 0xDC00 && (WideUnit) *ptr < 0xE000)
+			{
+				return 0x10000 + ((ch - 0xD800) << 10) + ((WideUnit) *ptr++ - 0xDC00);
+			}
+
+			return 0xFFFD;
+		}
+
+		return (ch > 0x10FFFF) ? 0xFFFD : ch;
+	}
+
+	//
+	// Runs of ASCII go through the block copier. Other characters are converted one at a time until the
+	// next ASCII one, so that text in other scripts does not pay for a block scan per character.
+	//
+
+	wchar_t * ConvertTo(std::u8string_view utf8, wchar_t * out) noexcept
+	{
+		auto ptr = utf8.data();
+		auto end = ptr + utf8.size();
+
+		while (ptr < end)
+		{
+			auto next = simd::CopyAscii(ptr, end, out);
+
+			out += next - ptr;
+			ptr = next;
+
+			while (ptr < end && *ptr >= 0x80)
+			{
+				out = EncodeWide(DecodeUtf8(ptr, end), out);
+			}
+		}
+
+		return out;
+	}
+
+	char8_t * ConvertTo(std::wstring_view wstr, char8_t * out) noexcept
+	{
+		auto ptr = wstr.data();
+		auto end = ptr + wstr.size();
+
+		while (ptr < end)
+		{
+			auto next = simd::CopyAscii(ptr, end, out);
+
+			out += next - ptr;
+			ptr = next;
+
+			while (ptr < end && (WideUnit) *ptr >= 0x80)
+			{
+				out = EncodeUtf8(DecodeWide(ptr, end), out);
+			}
+		}
+
+		return out;
+	}
+
+	std::u8string ConvertFrom(std::wstring_view wstr)
+	{
+		std::u8string utf8(MaxUtf8Length(wstr.size()), '\0');
+		utf8.resize(ConvertTo(wstr, utf8.data()) - utf8.data());
+		return utf8;
+	}
+
+	std::wstring ConvertFrom(std::u8string_view utf8)
+	{
+		std::wstring wstr(MaxWideLength(utf8.size()), L'\0');
+		wstr.resize(ConvertTo(utf8, wstr.data()) - wstr.data());
+		return wstr;
+	}
+
+	std::wstring ConvertFrom(std::span<const std::byte> data)
+	{
+		return ConvertFrom({ (const char8_t *) data.data(), data.size() });
+	}
+}
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <cstddef>
+#include <span>
+#include <string>
+#include <string_view>
+
+namespace custard
+{
+	//
+	// Conversion between UTF-8 and wchar_t strings, which hold UTF-16 on Windows and UTF-32 elsewhere.
+	//
+	// Ill-formed input is not an error. Each maximal ill-formed subsequence of UTF-8, and each unpaired
+	// surrogate, becomes U+FFFD, as with the Win32 converters.
+	//
+
+	// Decodes one code point and advances ptr past it. ptr must be before end.
+	inline char32_t DecodeUtf8(const char8_t *& ptr, const char8_t * end) noexcept
+	{
+		char32_t ch = *ptr++;
+
+		if (ch < 0x80)
+		{
+			return ch;
+		}
+
+		// The range of the second byte depends on the first, which rules out overlong forms, surrogates
+		// and code points past U+10FFFF (Unicode Table 3-7).
+		int trail;
+		char8_t lower = 0x80;
+		char8_t upper = 0xBF;
+
+		if (ch >= 0xC2 && ch <= 0xDF)
+		{
+			trail = 1;
+		}
+		else if (ch >= 0xE0 && ch <= 0xEF)
+		{
+			trail = 2;
+			lower = (ch == 0xE0) ? 0xA0 : 0x80;
+			upper = (ch == 0xED) ? 0x9F : 0xBF;
+		}
+		else if (ch >= 0xF0 && ch <= 0xF4)
+		{
+			trail = 3;
+			lower = (ch == 0xF0) ? 0x90 : 0x80;
+			upper = (ch == 0xF4) ? 0x8F : 0xBF;
+		}
+		else
+		{
+			return 0xFFFD;
+		}
+
+		ch &= (0x3F >> trail);
+
+		for (int i = 0; i < trail; i++, lower = 0x80, upper = 0xBF)
+		{
+			// The offending byte is left to start the next sequence.
+			if (ptr == end || *ptr < lower || *ptr > upper)
+			{
+				return 0xFFFD;
+			}
+
+			ch = (ch << 6) | (*ptr++ & 0x3F);
+		}
+
+		return ch;
+	}
+
+	// Encodes one code point, which must be a Unicode scalar value, and returns the end of the output.
+	inline wchar_t * EncodeWide(char32_t ch, wchar_t * out) noexcept
+	{
+		if (sizeof(wchar_t) == 2 && ch >= 0x10000)
+		{
+			ch -= 0x10000;
+			*out++ = (wchar_t) (0xD800 | (ch >> 10));
+			*out++ = (wchar_t) (0xDC00 | (ch & 0x3FF));
+			return out;
+		}
+
+		*out++ = (wchar_t) ch;
+		return out;
+	}
+
+	inline char8_t * EncodeUtf8(char32_t ch, char8_t * out) noexcept
+	{
+		if (ch < 0x80)
+		{
+			*out++ = (char8_t) ch;
+			return out;
+		}
+
+		if (ch < 0x800)
+		{
+			*out++ = (char8_t) (0xC0 | (ch >> 6));
+		}
+		else if (ch < 0x10000)
+		{
+			*out++ = (char8_t) (0xE0 | (ch >> 12));
+			*out++ = (char8_t) (0x80 | ((ch >> 6) & 0x3F));
+		}
+		else
+		{
+			*out++ = (char8_t) (0xF0 | (ch >> 18));
+			*out++ = (char8_t) (0x80 | ((ch >> 12) & 0x3F));
+			*out++ = (char8_t) (0x80 | ((ch >> 6) & 0x3F));
+		}
+
+		*out++ = (char8_t) (0x80 | (ch & 0x3F));
+		return out;
+	}
+
+	// The most code units a conversion of length code units can produce.
+	constexpr size_t MaxWideLength(size_t utf8Length) noexcept
+	{
+		return utf8Length;
+	}
+
+	constexpr size_t MaxUtf8Length(size_t wideLength) noexcept
+	{
+		return wideLength * ((sizeof(wchar_t) == 2) ? 3 : 4);
+	}
+
+	// Converts into out, which must have room for the maximum length, and returns the end of the output.
+	wchar_t * ConvertTo(std::u8string_view utf8, wchar_t * out) noexcept;
+	char8_t * ConvertTo(std::wstring_view wstr, char8_t * out) noexcept;
+
+	std::u8string ConvertFrom(std::wstring_view wstr);
+	std::wstring ConvertFrom(std::u8string_view utf8);
+	std::wstring ConvertFrom(std::span<const std::byte> data);
+}